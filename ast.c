@@ -3,37 +3,123 @@
 #include <string.h>
 #include <stdio.h>
 
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGN _Alignof(astNode)
+
+struct arenaChunk {
+    arenaChunk *next;
+    size_t used;
+    size_t size;
+    _Alignas(ARENA_ALIGN) char data[];
+};
+
+static _Thread_local astArena *currentArena;
+
+void initArena(astArena *arena){
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+}
+
+astArena *useArena(astArena *arena){
+    astArena *previous = currentArena;
+    currentArena = arena;
+    return previous;
+}
+
+// Chunks are kept in the order they were first used, so after a reset the
+// arena walks through the same chunks again. Oversized requests get a chunk
+// of their own right after the current one.
+void *arenaAlloc(astArena *arena, size_t size){
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    arenaChunk *chunk = arena->current;
+    while(chunk && chunk->size - chunk->used < size){
+        if(!chunk->next || size > ARENA_CHUNK_SIZE) break;
+        chunk = chunk->next;
+        arena->current = chunk;
+    }
+
+    if(!chunk || chunk->size - chunk->used < size){
+        size_t capacity = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        arenaChunk *fresh = malloc(sizeof(arenaChunk) + capacity);
+        if(!fresh) return NULL;
+
+        fresh->used = 0;
+        fresh->size = capacity;
+        if(chunk){
+            fresh->next = chunk->next;
+            chunk->next = fresh;
+        } else {
+            fresh->next = NULL;
+            arena->first = fresh;
+        }
+        if(size <= ARENA_CHUNK_SIZE || !chunk) arena->current = fresh;
+        chunk = fresh;
+    }
+
+    void *memory = &chunk->data[chunk->used];
+    chunk->used += size;
+    arena->used += size;
+    return memory;
+}
+
+void resetArena(astArena *arena){
+    arenaChunk **link = &arena->first;
+    while(*link){
+        arenaChunk *chunk = *link;
+        if(chunk->size > ARENA_CHUNK_SIZE){
+            *link = chunk->next;
+            free(chunk);
+            continue;
+        }
+        chunk->used = 0;
+        link = &chunk->next;
+    }
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+void freeArena(astArena *arena){
+    while(arena->first){
+        arenaChunk *next = arena->first->next;
+        free(arena->first);
+        arena->first = next;
+    }
+    if(currentArena == arena) currentArena = NULL;
+    initArena(arena);
+}
+
+static void *allocMemory(size_t size){
+    return currentArena ? arenaAlloc(currentArena, size) : malloc(size);
+}
+
+static void releaseMemory(void *memory, bool in_arena){
+    if(!in_arena) free(memory);
+}
+
 static astNode *allocNode(nodeType type){
-    astNode *node = malloc(sizeof(astNode));
+    astNode *node = allocMemory(sizeof(astNode));
     if(!node) return NULL;
 
     node->type = type;
+    node->in_arena = currentArena != NULL;
     return node;
 }
 
-astNode *createIdentifierNode(char *name){
+astNode *createIdentifierNode(const char *name){
     astNode *node = allocNode(identifier_node);
-    node->identifier.name = strdup(name);
+    if(!node) return NULL;
 
-    if(!node->identifier.name){
-        free(node);
-        return NULL;
-    }
+    node->identifier.name = name;
     return node;
 }
 
 astNode *createValueNode(dataValue *value){
     astNode *node = allocNode(value_node);
-    dataValue *val = &node->data.value;
-
-    if(value->type == type_string){
-        val->type = type_string;
-        val->value.str_value = strdup(value->value.str_value);
-        if(!val->value.str_value){
-            free(node);
-            return NULL;
-        }
-    } else *val = *value;
+    if(!node) return NULL;
+
+    node->data.value = *value;
     return node;
 }
 
@@ -45,14 +131,10 @@ astNode *createAssignmentNode(astNode *left, astNode *right, opType op){
     return node;
 }
 
-astNode *createDefineNode(astNode *type, char *identifier, astNode *initializer, dataFlags flags){
+astNode *createDefineNode(astNode *type, const char *identifier, astNode *initializer, dataFlags flags){
     astNode *node = allocNode(define_node);
     node->define.type = type;
-    node->define.identifier = strdup(identifier);
-    if(!node->define.identifier){
-        free(node);
-        return NULL;
-    }
+    node->define.identifier = identifier;
     node->define.initializer = initializer;
     node->define.flags = flags;
     return node;
@@ -63,7 +145,7 @@ astNode *createPointerNode(astNode *ptr){
     node->pointer.ptr = ptr;
     
     if(!node->pointer.ptr){
-        free(node);
+        releaseMemory(node, node->in_arena);
         return NULL;
     }
     return node;
@@ -72,9 +154,9 @@ astNode *createPointerNode(astNode *ptr){
 astNode *createBodyNode(astNode **elements, int elements_count){
     astNode *node = allocNode(body_node);
 
-    node->body.elements = malloc(sizeof(astNode *) *elements_count);
+    node->body.elements = allocMemory(sizeof(astNode *) *elements_count);
     if(!node->body.elements){
-        free(node);
+        releaseMemory(node, node->in_arena);
         return NULL;
     }
     for(int i = 0; i < elements_count; i++){
@@ -99,14 +181,9 @@ astNode *createArrayAccessNode(astNode *array, astNode *index){
     return node;
 }
 
-astNode *createFunctionNode(char *identifier, astNode *return_type, astNode *params, astNode *body, dataFlags flags, int is_variadic){
+astNode *createFunctionNode(const char *identifier, astNode *return_type, astNode *params, astNode *body, dataFlags flags, int is_variadic){
     astNode *node = allocNode(function_node);
-    node->function.identifier = strdup(identifier);
-    if(!node->function.identifier){
-        free(node);
-        return NULL;
-    }
-
+    node->function.identifier = identifier;
     node->function.return_type = return_type;
     node->function.params = params;
     node->function.body = body;
@@ -201,75 +278,60 @@ astNode *createImportNode(astNode *identifier){
     return node;
 }
 
-astNode *createStructNode(char *identifier, astNode *body){
+astNode *createStructNode(const char *identifier, astNode *body){
     astNode *node = allocNode(struct_node);
-    node->struct_stmt.identifier = identifier ? strdup(identifier) : NULL;
+    node->struct_stmt.identifier = identifier;
     node->struct_stmt.body = body;
     return node;
 }
 
-astNode *createImplNode(char *trait_name, char *target, astNode *body){
+astNode *createImplNode(const char *trait_name, const char *target, astNode *body){
     astNode *node = allocNode(impl_node);
     if (!node) return NULL;
 
-    node->impl_stmt.trait_name = trait_name ? strdup(trait_name) : NULL;
-    
-    node->impl_stmt.target = strdup(target);
-    if (!node->impl_stmt.target) {
-        if (node->impl_stmt.trait_name) free(node->impl_stmt.trait_name);
-        free(node);
-        return NULL;
-    }
-
+    node->impl_stmt.trait_name = trait_name;
+    node->impl_stmt.target = target;
     node->impl_stmt.body = body;
     return node;
 }
 
-astNode *createTraitNode(char *identifier, astNode *body) {
+astNode *createTraitNode(const char *identifier, astNode *body) {
     astNode *node = allocNode(trait_node);
     if (!node) return NULL;
 
-    node->trait_stmt.identifier = identifier ? strdup(identifier) : NULL;
+    node->trait_stmt.identifier = identifier;
     node->trait_stmt.body = body;
     return node;
 }
 
-astNode *createDotAccessNode(astNode *object, char *member) {
+astNode *createDotAccessNode(astNode *object, const char *member) {
     astNode *node = allocNode(dot_access_node);
     if (!node) return NULL;
     
     node->dot_access.object = object;
-    node->dot_access.member = strdup(member);
-    if (!node->dot_access.member) {
-        free(node);
-        return NULL;
-    }
+    node->dot_access.member = member;
     return node;
 }
 
-astNode *createArrowAccessNode(astNode *object, char *member) {
+astNode *createArrowAccessNode(astNode *object, const char *member) {
     astNode *node = allocNode(arrow_access_node);
     if (!node) return NULL;
     
     node->arrow_access.object = object;
-    node->arrow_access.member = strdup(member);
-    if (!node->arrow_access.member) {
-        free(node);
-        return NULL;
-    }
+    node->arrow_access.member = member;
     return node;
 }
 
-astNode *createEnumNode(char *identifier, astNode *body){
+astNode *createEnumNode(const char *identifier, astNode *body){
     astNode *node = allocNode(enum_node);
-    node->enum_stmt.identifier = identifier ? strdup(identifier) : NULL;
+    node->enum_stmt.identifier = identifier;
     node->enum_stmt.body = body;
     return node;
 }
 
-astNode *createUnionNode(char *identifier, astNode *body){
+astNode *createUnionNode(const char *identifier, astNode *body){
     astNode *node = allocNode(union_node);
-    node->union_stmt.identifier = identifier ? strdup(identifier) : NULL;
+    node->union_stmt.identifier = identifier;
     node->union_stmt.body = body;
     return node;
 }
@@ -293,160 +355,371 @@ astNode *createCastNode(astNode *type, astNode *operand){
     return node;
 }
 
-astNode *createTypedefNode(astNode *type, char *alias_name){
+astNode *createTypedefNode(astNode *type, const char *alias_name){
     astNode *node = allocNode(typedef_node);
     if(!node) return NULL;
 
     node->typedef_stmt.type = type;
-    node->typedef_stmt.alias_name = strdup(alias_name);
+    node->typedef_stmt.alias_name = alias_name;
+    return node;
+}
 
-    if(!node->typedef_stmt.alias_name){
-        free(node);
-        return NULL;
-    }
+astNode *createLazyBodyNode(const char *src, long long start, long long end){
+    astNode *node = allocNode(lazy_body_node);
+    if(!node) return NULL;
+
+    node->lazy_body.src = src;
+    node->lazy_body.start = start;
+    node->lazy_body.end = end;
     return node;
 }
 
-void freeAst(astNode *node){
-    if(!node) return;
+// Children of fixed-arity nodes are copied into the frame; body nodes are
+// read straight from their element array.
+typedef struct {
+    astNode *node;
+    astNode *children[4];
+    int count;
+    int next;
+} walkFrame;
+
+#define WALK_INLINE_DEPTH 64
+
+static void enterFrame(walkFrame *frame, astNode *node){
+    astNode **children = frame->children;
+    int count = 0;
 
     switch(node->type){
-        case identifier_node:
-            free(node->identifier.name);
-            break;
-        case value_node:
-            if(node->data.value.type == type_string){
-                free(node->data.value.value.str_value);
-            }
-            break;
         case assignment_node:
-            freeAst(node->assignment.left);
-            freeAst(node->assignment.right);
+            children[count++] = node->assignment.left;
+            children[count++] = node->assignment.right;
             break;
         case define_node:
-            freeAst(node->define.type);
-            free(node->define.identifier);
-            freeAst(node->define.initializer);
+            children[count++] = node->define.type;
+            children[count++] = node->define.initializer;
             break;
         case pointer_node:
-            freeAst(node->pointer.ptr);
+            children[count++] = node->pointer.ptr;
             break;
         case body_node:
-            for(int i = 0; i < node->body.elements_count; i++){
-                freeAst(node->body.elements[i]);
-            }
-            free(node->body.elements);
+            count = node->body.elements_count;
             break;
         case array_node:
-            freeAst(node->array.type);
-            freeAst(node->array.size);
-            freeAst(node->array.elements);
+            children[count++] = node->array.type;
+            children[count++] = node->array.size;
+            children[count++] = node->array.elements;
             break;
         case array_access_node:
-            freeAst(node->array_access.array);
-            freeAst(node->array_access.index);
+            children[count++] = node->array_access.array;
+            children[count++] = node->array_access.index;
             break;
         case function_node:
-            free(node->function.identifier);
-            freeAst(node->function.return_type);
-            freeAst(node->function.params);
-            freeAst(node->function.body);
+            children[count++] = node->function.return_type;
+            children[count++] = node->function.params;
+            children[count++] = node->function.body;
             break;
         case call_node:
-            freeAst(node->call.identifier);
-            freeAst(node->call.args);
+            children[count++] = node->call.identifier;
+            children[count++] = node->call.args;
             break;
         case data_operation_node:
-            freeAst(node->operation.left);
-            freeAst(node->operation.right);
+            children[count++] = node->operation.left;
+            children[count++] = node->operation.right;
             break;
         case if_node:
-            freeAst(node->if_stmt.condition);
-            freeAst(node->if_stmt.then_branch);
-            freeAst(node->if_stmt.else_branch);
+            children[count++] = node->if_stmt.condition;
+            children[count++] = node->if_stmt.then_branch;
+            children[count++] = node->if_stmt.else_branch;
             break;
         case switch_node:
-            freeAst(node->switch_stmt.condition);
-            freeAst(node->switch_stmt.body);
+            children[count++] = node->switch_stmt.condition;
+            children[count++] = node->switch_stmt.body;
             break;
         case case_node:
-            freeAst(node->case_stmt.value);
-            break;
-        case default_node:
+            children[count++] = node->case_stmt.value;
             break;
         case for_node:
-            freeAst(node->for_stmt.initializer);
-            freeAst(node->for_stmt.condition);
-            freeAst(node->for_stmt.increment);
-            freeAst(node->for_stmt.then_branch);
+            children[count++] = node->for_stmt.initializer;
+            children[count++] = node->for_stmt.condition;
+            children[count++] = node->for_stmt.increment;
+            children[count++] = node->for_stmt.then_branch;
             break;
         case while_node:
-            freeAst(node->while_stmt.condition);
-            freeAst(node->while_stmt.then_branch);
+            children[count++] = node->while_stmt.condition;
+            children[count++] = node->while_stmt.then_branch;
             break;
         case do_while_node:
-            freeAst(node->do_while_stmt.body);
-            freeAst(node->do_while_stmt.condition);
-            break;
-        case break_node:
-            break;
-        case continue_node:
+            children[count++] = node->do_while_stmt.body;
+            children[count++] = node->do_while_stmt.condition;
             break;
         case return_node:
-            freeAst(node->return_stmt.value);
+            children[count++] = node->return_stmt.value;
             break;
         case import_node:
-            freeAst(node->import_stmt.identifier);
+            children[count++] = node->import_stmt.identifier;
             break;
         case struct_node:
-            free(node->struct_stmt.identifier);
-            freeAst(node->struct_stmt.body);
+            children[count++] = node->struct_stmt.body;
             break;
         case impl_node:
-            if(node->impl_stmt.trait_name){
-                free(node->impl_stmt.trait_name);
-            }
-            free(node->impl_stmt.target);
-            freeAst(node->impl_stmt.body);
+            children[count++] = node->impl_stmt.body;
             break;
         case trait_node:
-            if(node->trait_stmt.identifier){
-                free(node->trait_stmt.identifier);
-            }
-            freeAst(node->trait_stmt.body);
+            children[count++] = node->trait_stmt.body;
             break;
         case dot_access_node:
-            freeAst(node->dot_access.object);
-            free(node->dot_access.member);
+            children[count++] = node->dot_access.object;
             break;
         case arrow_access_node:
-            freeAst(node->arrow_access.object);
-            free(node->arrow_access.member);
+            children[count++] = node->arrow_access.object;
             break;
         case enum_node:
-            free(node->enum_stmt.identifier);
-            freeAst(node->enum_stmt.body);
+            children[count++] = node->enum_stmt.body;
             break;
         case union_node:
-            free(node->union_stmt.identifier);
-            freeAst(node->union_stmt.body);
+            children[count++] = node->union_stmt.body;
             break;
         case sizeof_node:
-            freeAst(node->sizeof_expr.operand);
+            children[count++] = node->sizeof_expr.operand;
             break;
         case typeof_node:
-            freeAst(node->typeof_expr.operand);
+            children[count++] = node->typeof_expr.operand;
             break;
         case cast_node:
-            freeAst(node->cast_expr.type);
-            freeAst(node->cast_expr.operand);
+            children[count++] = node->cast_expr.type;
+            children[count++] = node->cast_expr.operand;
             break;
         case typedef_node:
-            freeAst(node->typedef_stmt.type);
-            free(node->typedef_stmt.alias_name);
+            children[count++] = node->typedef_stmt.type;
             break;
         default:
             break;
     }
+    frame->node = node;
+    frame->count = count;
+    frame->next = 0;
+
+    // Siblings are needed right after the first child's subtree; start
+    // loading them now.
+    if(node->type == body_node){
+        for(int i = 0; i < count && i < 4; i++) __builtin_prefetch(node->body.elements[i]);
+    } else {
+        for(int i = 0; i < count; i++){
+            if(children[i]) __builtin_prefetch(children[i]);
+        }
+    }
+}
+
+// The work stack starts on the C stack and moves to the heap only for trees
+// deeper than WALK_INLINE_DEPTH, so shallow walks do not allocate. Passes in
+// this file call walk directly so their callbacks can be inlined.
+static inline bool walk(astNode *node, astEnter enter, astLeave leave, void *ctx){
+    if(!node || (enter && !enter(node, 0, ctx))) return true;
+
+    walkFrame inline_frames[WALK_INLINE_DEPTH];
+    walkFrame *frames = inline_frames;
+    int capacity = WALK_INLINE_DEPTH;
+    int depth = 1;
+    bool ok = true;
+    enterFrame(&frames[0], node);
+
+    while(depth > 0){
+        walkFrame *frame = &frames[depth - 1];
+        if(frame->next == frame->count){
+            depth--;
+            if(leave) leave(frame->node, depth, ctx);
+            continue;
+        }
+
+        int index = frame->next++;
+        astNode *child;
+        if(frame->node->type == body_node){
+            child = frame->node->body.elements[index];
+            if(index + 4 < frame->count) __builtin_prefetch(frame->node->body.elements[index + 4]);
+        } else {
+            child = frame->children[index];
+        }
+        if(!child || (enter && !enter(child, depth, ctx))) continue;
+
+        if(depth == capacity){
+            walkFrame *grown = malloc(sizeof(walkFrame) * capacity * 2);
+            if(!grown){
+                ok = false;
+                break;
+            }
+            memcpy(grown, frames, sizeof(walkFrame) * depth);
+            if(frames != inline_frames) free(frames);
+            frames = grown;
+            capacity *= 2;
+        }
+
+        // Leaves are done as soon as they are entered and never take a frame.
+        enterFrame(&frames[depth], child);
+        if(frames[depth].count == 0){
+            if(leave) leave(child, depth, ctx);
+            continue;
+        }
+        depth++;
+    }
+
+    if(frames != inline_frames) free(frames);
+    return ok;
+}
+
+bool walkAst(astNode *node, astEnter enter, astLeave leave, void *ctx){
+    return walk(node, enter, leave, ctx);
+}
+
+static bool enterFree(astNode *node, int depth, void *ctx){
+    (void)depth;
+    (void)ctx;
+    return !node->in_arena;
+}
+
+static void leaveFree(astNode *node, int depth, void *ctx){
+    (void)depth;
+    (void)ctx;
+    if(node->type == body_node) free(node->body.elements);
     free(node);
 }
+
+void freeAst(astNode *node){
+    walk(node, enterFree, leaveFree, NULL);
+}
+
+static const char *nodeNames[] = {
+    [identifier_node] = "identifier",
+    [value_node] = "value",
+    [assignment_node] = "assignment",
+    [define_node] = "define",
+    [pointer_node] = "pointer",
+    [body_node] = "body",
+    [array_node] = "array",
+    [array_access_node] = "array_access",
+    [function_node] = "function",
+    [call_node] = "call",
+    [data_operation_node] = "operation",
+    [if_node] = "if",
+    [switch_node] = "switch",
+    [case_node] = "case",
+    [default_node] = "default",
+    [for_node] = "for",
+    [while_node] = "while",
+    [do_while_node] = "do_while",
+    [break_node] = "break",
+    [continue_node] = "continue",
+    [return_node] = "return",
+    [import_node] = "import",
+    [trait_node] = "trait",
+    [impl_node] = "impl",
+    [struct_node] = "struct",
+    [dot_access_node] = "dot_access",
+    [arrow_access_node] = "arrow_access",
+    [enum_node] = "enum",
+    [union_node] = "union",
+    [sizeof_node] = "sizeof",
+    [typeof_node] = "typeof",
+    [cast_node] = "cast",
+    [typedef_node] = "typedef",
+    [lazy_body_node] = "lazy_body",
+};
+
+static const char *opNames[] = {
+    [plus_op] = "+", [increment_op] = "++", [minus_op] = "-", [decrement_op] = "--",
+    [star_op] = "*", [slash_op] = "/", [percent_op] = "%",
+    [bitwise_and_op] = "&", [bitwise_or_op] = "|", [bitwise_xor_op] = "^",
+    [bitwise_not_op] = "~", [shift_left_op] = "<<", [shift_right_op] = ">>",
+    [and_op] = "&&", [or_op] = "||", [not_op] = "!",
+    [equal_op] = "==", [not_equal_op] = "!=", [less_op] = "<", [greater_op] = ">",
+    [less_or_equal_op] = "<=", [greater_or_equal_op] = ">=",
+    [assignment_op] = "=", [plus_assignment_op] = "+=", [minus_assignment_op] = "-=",
+    [star_assignment_op] = "*=", [slash_assignment_op] = "/=", [percent_assignment_op] = "%=",
+    [bitwise_and_assignment_op] = "&=", [bitwise_or_assignment_op] = "|=",
+    [bitwise_xor_assignment_op] = "^=", [shift_left_assignment_op] = "<<=",
+    [shift_right_assignment_op] = ">>=",
+    [dereference_op] = "*", [address_op] = "&",
+};
+
+static void printValue(dataValue *value){
+    switch(value->type){
+        case type_bool: printf(" %s", value->value.b_value ? "true" : "false"); break;
+        case type_short: printf(" %hd", value->value.s_value); break;
+        case type_ushort: printf(" %hu", value->value.us_value); break;
+        case type_int: printf(" %d", value->value.i_value); break;
+        case type_uint: printf(" %u", value->value.ui_value); break;
+        case type_long: printf(" %ld", value->value.l_value); break;
+        case type_ulong: printf(" %lu", value->value.ul_value); break;
+        case type_long_long: printf(" %lld", value->value.ll_value); break;
+        case type_ullong: printf(" %llu", value->value.ull_value); break;
+        case type_float: printf(" %g", value->value.f_value); break;
+        case type_double: printf(" %g", value->value.d_value); break;
+        case type_long_double: printf(" %Lg", value->value.ld_value); break;
+        case type_string: printf(" \"%s\"", value->value.str_value); break;
+        case type_null: printf(" null"); break;
+        default: break;
+    }
+}
+
+static bool enterPrint(astNode *node, int depth, void *ctx){
+    printf("%*s%s", (*(int *)ctx + depth) * 2, "", nodeNames[node->type]);
+
+    switch(node->type){
+        case identifier_node:
+            printf(" %s", node->identifier.name);
+            break;
+        case value_node:
+            printValue(&node->data.value);
+            break;
+        case assignment_node:
+            printf(" %s", opNames[node->assignment.op]);
+            break;
+        case data_operation_node:
+            printf(" %s", opNames[node->operation.op]);
+            break;
+        case define_node:
+            printf(" %s", node->define.identifier);
+            break;
+        case body_node:
+            printf(" (%d)", node->body.elements_count);
+            break;
+        case function_node:
+            printf(" %s%s", node->function.identifier, node->function.is_variadic ? " ..." : "");
+            break;
+        case impl_node:
+            if(node->impl_stmt.trait_name) printf(" %s for", node->impl_stmt.trait_name);
+            printf(" %s", node->impl_stmt.target);
+            break;
+        case struct_node:
+            if(node->struct_stmt.identifier) printf(" %s", node->struct_stmt.identifier);
+            break;
+        case trait_node:
+            if(node->trait_stmt.identifier) printf(" %s", node->trait_stmt.identifier);
+            break;
+        case enum_node:
+            if(node->enum_stmt.identifier) printf(" %s", node->enum_stmt.identifier);
+            break;
+        case union_node:
+            if(node->union_stmt.identifier) printf(" %s", node->union_stmt.identifier);
+            break;
+        case dot_access_node:
+            printf(" .%s", node->dot_access.member);
+            break;
+        case arrow_access_node:
+            printf(" ->%s", node->arrow_access.member);
+            break;
+        case typedef_node:
+            printf(" %s", node->typedef_stmt.alias_name);
+            break;
+        case lazy_body_node:
+            printf(" [%lld, %lld)", node->lazy_body.start, node->lazy_body.end);
+            break;
+        default:
+            break;
+    }
+    printf("\n");
+    return true;
+}
+
+void printAst(astNode *node, int level){
+    walkAst(node, enterPrint, NULL, &level);
+}
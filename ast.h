@@ -1,6 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 typedef enum {
     type_void,
     type_bool,
@@ -34,7 +37,7 @@ typedef struct {
         float f_value;
         double d_value;
         long double ld_value;
-        char* str_value;
+        const char* str_value;
     } value;
 } dataValue;
 
@@ -122,16 +125,23 @@ typedef enum {
     sizeof_node,
     typeof_node,
     cast_node,
-    typedef_node
+    typedef_node,
+    lazy_body_node
 } nodeType;
 
 typedef struct astNode astNode;
 
+// Names are canonical strings from the atom table (atom.h) and string values
+// come from its literal pool. Nodes point at them without owning them, so
+// equal names are equal pointers.
+
 typedef struct astNode {
     nodeType type;
+    // Set for nodes carved out of an arena, which freeAst leaves to the arena.
+    bool in_arena;
     union {
         struct {
-            char *name;
+            const char *name;
         } identifier;
 
         struct {
@@ -146,7 +156,7 @@ typedef struct astNode {
 
         struct {
             astNode *type;
-            char *identifier;
+            const char *identifier;
             astNode *initializer;
             dataFlags flags;
         } define;
@@ -172,7 +182,7 @@ typedef struct astNode {
         } array_access;
 
         struct {
-            char *identifier;
+            const char *identifier;
             astNode *return_type;
             astNode *params;
             astNode *body;
@@ -232,38 +242,38 @@ typedef struct astNode {
         } import_stmt;
 
         struct {
-            char *identifier;
+            const char *identifier;
             astNode *body;
         } struct_stmt;
 
         struct {
-            char *trait_name;
-            char *target;
+            const char *trait_name;
+            const char *target;
             astNode *body;
         } impl_stmt;
 
         struct {
-            char *identifier;
+            const char *identifier;
             astNode *body;
         } trait_stmt;
 
         struct {
             astNode *object;
-            char *member;
+            const char *member;
         } dot_access;
 
         struct {
             astNode *object;
-            char *member;
+            const char *member;
         } arrow_access;
 
         struct {
-            char *identifier;
+            const char *identifier;
             astNode *body;
         } enum_stmt;
 
         struct {
-            char *identifier;
+            const char *identifier;
             astNode *body;
         } union_stmt;
 
@@ -282,20 +292,28 @@ typedef struct astNode {
 
         struct {
             astNode *type;
-            char *alias_name;
+            const char *alias_name;
         } typedef_stmt;
+
+        // A function body that has not been parsed yet: bytes [start, end)
+        // of src, braces included. See functionBody in parser.h.
+        struct {
+            const char *src;
+            long long start;
+            long long end;
+        } lazy_body;
     };
 } astNode;
 
-astNode *createIdentifierNode(char *name);
+astNode *createIdentifierNode(const char *name);
 astNode *createValueNode(dataValue *value);
 astNode *createAssignmentNode(astNode *left, astNode *right, opType op);
-astNode *createDefineNode(astNode *type, char *identifier, astNode *initializer, dataFlags flags);
+astNode *createDefineNode(astNode *type, const char *identifier, astNode *initializer, dataFlags flags);
 astNode *createPointerNode(astNode *pointer);
 astNode *createBodyNode(astNode **elements, int elements_count);
 astNode *createArrayNode(astNode *type, astNode *size, astNode *elements);
 astNode *createArrayAccessNode(astNode *array, astNode *index);
-astNode *createFunctionNode(char *identifier, astNode *return_type, astNode *params, astNode *body, dataFlags flags, int is_variadic);
+astNode *createFunctionNode(const char *identifier, astNode *return_type, astNode *params, astNode *body, dataFlags flags, int is_variadic);
 astNode *createCallNode(astNode *identifier, astNode *args);
 astNode *createDataOperationNode(astNode *left, astNode *right, opType op);
 astNode *createIfNode(astNode *condition, astNode *then_branch, astNode *else_branch);
@@ -309,19 +327,50 @@ astNode *createBreakNode();
 astNode *createContinueNode();
 astNode *createReturnNode(astNode *value);
 astNode *createImportNode(astNode *identifier);
-astNode *createStructNode(char *identifier, astNode *body);
-astNode *createImplNode(char *trait_name, char *target, astNode *body);
-astNode *createTraitNode(char *identifier, astNode *body);
-astNode *createDotAccessNode(astNode *object, char *member);
-astNode *createArrowAccessNode(astNode *object, char *member);
-astNode *createEnumNode(char *identifier, astNode *body);
-astNode *createUnionNode(char *identifier, astNode *body);
+astNode *createStructNode(const char *identifier, astNode *body);
+astNode *createImplNode(const char *trait_name, const char *target, astNode *body);
+astNode *createTraitNode(const char *identifier, astNode *body);
+astNode *createDotAccessNode(astNode *object, const char *member);
+astNode *createArrowAccessNode(astNode *object, const char *member);
+astNode *createEnumNode(const char *identifier, astNode *body);
+astNode *createUnionNode(const char *identifier, astNode *body);
 astNode *createSizeofNode(astNode *operand);
 astNode *createTypeofNode(astNode *operand);
 astNode *createCastNode(astNode *type, astNode *operand);
-astNode *createTypedefNode(astNode *type, char *alias_name);
-
+astNode *createTypedefNode(astNode *type, const char *alias_name);
+astNode *createLazyBodyNode(const char *src, long long start, long long end);
+
+// Walks a tree depth-first with an explicit stack, so depth is limited by
+// memory rather than the C stack. enter sees each node before its children
+// and returns false to skip them; leave sees it after them, and only if
+// enter let it in. depth is 0 for node itself. Either callback may be NULL.
+// Returns false if the stack could not grow and the walk stopped early.
+typedef bool (*astEnter)(astNode *node, int depth, void *ctx);
+typedef void (*astLeave)(astNode *node, int depth, void *ctx);
+bool walkAst(astNode *node, astEnter enter, astLeave leave, void *ctx);
+
+// One line per node, indented two spaces per level.
 void printAst(astNode *node, int level);
 void freeAst(astNode *node);
 
+typedef struct arenaChunk arenaChunk;
+
+// While an arena is in use on a thread, every node and child array created
+// on that thread is bump-allocated from it. freeAst skips such nodes; they
+// all go away at once with resetArena, which keeps the memory for the next
+// parse, or freeArena.
+typedef struct {
+    arenaChunk *first;
+    arenaChunk *current;
+    size_t used;
+} astArena;
+
+void initArena(astArena *arena);
+// Makes arena the current thread's arena and returns the previous one.
+// NULL goes back to malloc.
+astArena *useArena(astArena *arena);
+void *arenaAlloc(astArena *arena, size_t size);
+void resetArena(astArena *arena);
+void freeArena(astArena *arena);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,442 @@
+#include "astcache.h"
+#include "atom.h"
+#include "parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BINARY_AST_BYTE_ORDER 0x0102
+
+static bool reserve(void **items, uint32_t *capacity, uint32_t needed, size_t size){
+    if(needed <= *capacity) return true;
+
+    uint32_t grown = *capacity ? *capacity : 256;
+    while(grown < needed) grown *= 2;
+
+    void *resized = realloc(*items, grown * size);
+    if(!resized) return false;
+
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+// Strings as they will be written, plus which atoms already have one.
+typedef struct {
+    uint32_t *offsets;
+    uint32_t count;
+    uint32_t capacity;
+
+    char *text;
+    uint32_t text_bytes;
+    uint32_t text_capacity;
+
+    uint32_t *atoms;
+    uint32_t atom_capacity;
+} stringTable;
+
+static uint32_t addString(stringTable *table, const char *text, size_t length, bool *ok){
+    if(!*ok) return 0;
+    if(!reserve((void **)&table->offsets, &table->capacity, table->count + 1, sizeof(uint32_t)) ||
+       !reserve((void **)&table->text, &table->text_capacity, table->text_bytes + length + 1, 1)){
+        *ok = false;
+        return 0;
+    }
+
+    table->offsets[table->count] = table->text_bytes;
+    memcpy(&table->text[table->text_bytes], text, length);
+    table->text[table->text_bytes + length] = '\0';
+    table->text_bytes += length + 1;
+    return table->count++;
+}
+
+static uint32_t atomString(stringTable *table, atom id, bool *ok){
+    if(!id || !*ok) return 0;
+
+    uint32_t capacity = table->atom_capacity;
+    if(!reserve((void **)&table->atoms, &table->atom_capacity, id + 1, sizeof(uint32_t))){
+        *ok = false;
+        return 0;
+    }
+    if(table->atom_capacity > capacity){
+        memset(&table->atoms[capacity], 0, (table->atom_capacity - capacity) * sizeof(uint32_t));
+    }
+
+    if(!table->atoms[id]){
+        const char *name = atomName(id);
+        table->atoms[id] = addString(table, name, nameLength(name), ok);
+    }
+    return table->atoms[id];
+}
+
+static void freeStringTable(stringTable *table){
+    free(table->offsets);
+    free(table->text);
+    free(table->atoms);
+}
+
+// Swaps the atoms of a node copied from a flatAst for string indices.
+static void nameStrings(flatNode *node, uint32_t *extra, stringTable *table, bool *ok){
+    switch(node->type){
+        case identifier_node:
+        case struct_node:
+        case trait_node:
+        case enum_node:
+        case union_node:
+            node->lhs = atomString(table, node->lhs, ok);
+            break;
+        case dot_access_node:
+        case arrow_access_node:
+        case typedef_node:
+            node->rhs = atomString(table, node->rhs, ok);
+            break;
+        case define_node:
+            extra[node->rhs] = atomString(table, extra[node->rhs], ok);
+            break;
+        case function_node:
+            extra[node->lhs] = atomString(table, extra[node->lhs], ok);
+            break;
+        case impl_node:
+            extra[node->lhs] = atomString(table, extra[node->lhs], ok);
+            extra[node->lhs + 1] = atomString(table, extra[node->lhs + 1], ok);
+            break;
+        default:
+            break;
+    }
+}
+
+static uint64_t align8(uint64_t offset){
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+void *writeBinaryAst(flatAst *ast, const uint32_t *roots, uint32_t root_count, bool complete, const char *src, long long length, size_t *size){
+    static const flatNode placeholder = {0};
+    const flatNode *nodes = ast->node_count ? ast->nodes : &placeholder;
+    uint32_t node_count = ast->node_count ? ast->node_count : 1;
+
+    binaryAstHeader header = {0};
+    memcpy(header.magic, BINARY_AST_MAGIC, sizeof(header.magic));
+    header.version = BINARY_AST_VERSION;
+    header.byte_order = BINARY_AST_BYTE_ORDER;
+    header.value_size = sizeof(binaryValue);
+    header.parser_revision = PARSER_REVISION;
+    header.complete = complete;
+    header.source_hash = hashSource(src, length);
+    header.source_length = length;
+    header.node_count = node_count;
+    header.extra_count = ast->extra_count;
+    header.root_count = root_count;
+    header.value_count = ast->value_count;
+
+    header.nodes = align8(sizeof(binaryAstHeader));
+    header.extra = align8(header.nodes + (uint64_t)node_count * sizeof(flatNode));
+    header.roots = align8(header.extra + (uint64_t)ast->extra_count * sizeof(uint32_t));
+    header.values = align8(header.roots + (uint64_t)root_count * sizeof(uint32_t));
+    header.strings = align8(header.values + (uint64_t)ast->value_count * sizeof(binaryValue));
+
+    // Nodes, extra, roots and values have a known size, so they go straight
+    // into a buffer that is grown once the strings are known.
+    char *data = calloc(1, header.strings);
+    if(!data) return NULL;
+
+    flatNode *out_nodes = (flatNode *)(data + header.nodes);
+    uint32_t *out_extra = (uint32_t *)(data + header.extra);
+    binaryValue *out_values = (binaryValue *)(data + header.values);
+    memcpy(out_nodes, nodes, node_count * sizeof(flatNode));
+    if(ast->extra_count > 0) memcpy(out_extra, ast->extra, ast->extra_count * sizeof(uint32_t));
+    if(root_count > 0) memcpy(data + header.roots, roots, root_count * sizeof(uint32_t));
+
+    bool ok = true;
+    stringTable table = {0};
+    addString(&table, "", 0, &ok);
+    for(uint32_t i = 1; i < node_count; i++) nameStrings(&out_nodes[i], out_extra, &table, &ok);
+    for(uint32_t i = 0; i < ast->value_count; i++){
+        dataValue *value = &ast->values[i];
+        out_values[i].type = value->type;
+        if(value->type == type_string){
+            const char *text = value->value.str_value;
+            if(text) out_values[i].string = addString(&table, text, nameLength(text), &ok);
+        } else {
+            memcpy(out_values[i].bits, &value->value, sizeof(out_values[i].bits));
+        }
+    }
+
+    header.string_count = table.count;
+    header.text_bytes = table.text_bytes;
+    header.text = header.strings + (uint64_t)table.count * sizeof(uint32_t);
+    header.source = header.text + table.text_bytes;
+    *size = header.source + length;
+
+    char *grown = ok ? realloc(data, *size) : NULL;
+    if(!grown){
+        free(data);
+        freeStringTable(&table);
+        return NULL;
+    }
+    data = grown;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + header.strings, table.offsets, table.count * sizeof(uint32_t));
+    memcpy(data + header.text, table.text, table.text_bytes);
+    if(length > 0) memcpy(data + header.source, src, length);
+    freeStringTable(&table);
+    return data;
+}
+
+static bool sectionFits(size_t size, uint64_t offset, uint64_t count, size_t item){
+    return offset % sizeof(uint32_t) == 0 && offset <= size && count <= (size - offset) / item;
+}
+
+// Bounds for checking a node: children must come before it.
+typedef struct {
+    const binaryAstHeader *header;
+    const uint32_t *extra;
+    uint32_t index;
+} nodeCheck;
+
+static bool childFits(nodeCheck *check, uint32_t child){
+    return child < check->index;
+}
+
+static bool stringFits(nodeCheck *check, uint32_t string){
+    return string < check->header->string_count;
+}
+
+static bool extraFits(nodeCheck *check, uint32_t start, uint32_t count){
+    return (uint64_t)start + count <= check->header->extra_count;
+}
+
+static bool childrenFit(nodeCheck *check, uint32_t start, uint32_t count){
+    if(!extraFits(check, start, count)) return false;
+    for(uint32_t i = 0; i < count; i++){
+        if(!childFits(check, check->extra[start + i])) return false;
+    }
+    return true;
+}
+
+static bool nodeFits(nodeCheck *check, const flatNode *node, const binaryValue *values){
+    const uint32_t *extra = check->extra;
+    switch(node->type){
+        case identifier_node:
+            return stringFits(check, node->lhs);
+        case value_node:
+            if(node->op > type_null) return false;
+            if(isInlineValue((dataType)node->op)) return true;
+            if(node->lhs >= check->header->value_count) return false;
+            if(values[node->lhs].type != node->op) return false;
+            return node->op != type_string || stringFits(check, values[node->lhs].string);
+        case define_node:
+            return childFits(check, node->lhs) && extraFits(check, node->rhs, 2) &&
+                   stringFits(check, extra[node->rhs]) && childFits(check, extra[node->rhs + 1]);
+        case body_node:
+            return childrenFit(check, node->lhs, node->rhs);
+        case array_node:
+            return childrenFit(check, node->lhs, 3);
+        case function_node:
+            return extraFits(check, node->lhs, 4) && stringFits(check, extra[node->lhs]) && childrenFit(check, node->lhs + 1, 3);
+        case if_node:
+            return childFits(check, node->lhs) && childrenFit(check, node->rhs, 2);
+        case for_node:
+            return childrenFit(check, node->lhs, 4);
+        case impl_node:
+            return extraFits(check, node->lhs, 2) && stringFits(check, extra[node->lhs]) &&
+                   stringFits(check, extra[node->lhs + 1]) && childFits(check, node->rhs);
+        case struct_node:
+        case trait_node:
+        case enum_node:
+        case union_node:
+            return stringFits(check, node->lhs) && childFits(check, node->rhs);
+        case dot_access_node:
+        case arrow_access_node:
+        case typedef_node:
+            return childFits(check, node->lhs) && stringFits(check, node->rhs);
+        case lazy_body_node:
+            return node->lhs <= node->rhs && node->rhs <= check->header->source_length;
+        default:
+            if(node->type > lazy_body_node) return false;
+            return childFits(check, node->lhs) && childFits(check, node->rhs);
+    }
+}
+
+bool readBinaryAst(binaryAst *ast, const void *data, size_t size){
+    const binaryAstHeader *header = data;
+    if(size < sizeof(binaryAstHeader)) return false;
+    if(memcmp(header->magic, BINARY_AST_MAGIC, sizeof(header->magic)) != 0) return false;
+    if(header->version != BINARY_AST_VERSION || header->byte_order != BINARY_AST_BYTE_ORDER) return false;
+    if(header->value_size != sizeof(binaryValue)) return false;
+
+    if(header->node_count == 0 || header->string_count == 0 || header->text_bytes == 0) return false;
+    if(!sectionFits(size, header->nodes, header->node_count, sizeof(flatNode)) ||
+       !sectionFits(size, header->extra, header->extra_count, sizeof(uint32_t)) ||
+       !sectionFits(size, header->roots, header->root_count, sizeof(uint32_t)) ||
+       !sectionFits(size, header->values, header->value_count, sizeof(binaryValue)) ||
+       !sectionFits(size, header->strings, header->string_count, sizeof(uint32_t)) ||
+       header->text > size || header->text_bytes > size - header->text ||
+       header->source > size || header->source_length > size - header->source){
+        return false;
+    }
+
+    const char *base = data;
+    const flatNode *nodes = (const flatNode *)(base + header->nodes);
+    const uint32_t *roots = (const uint32_t *)(base + header->roots);
+    const binaryValue *values = (const binaryValue *)(base + header->values);
+    const uint32_t *strings = (const uint32_t *)(base + header->strings);
+    const char *text = base + header->text;
+
+    // Every string starts inside text, and text ends in '\0', so every
+    // string is terminated.
+    if(text[header->text_bytes - 1] != '\0') return false;
+    for(uint32_t i = 0; i < header->string_count; i++){
+        if(strings[i] >= header->text_bytes) return false;
+    }
+
+    nodeCheck check = {header, (const uint32_t *)(base + header->extra), 0};
+    for(check.index = 1; check.index < header->node_count; check.index++){
+        if(!nodeFits(&check, &nodes[check.index], values)) return false;
+    }
+    for(uint32_t i = 0; i < header->root_count; i++){
+        if(roots[i] == 0 || roots[i] >= header->node_count) return false;
+    }
+
+    memset(ast, 0, sizeof(binaryAst));
+    ast->header = header;
+    ast->nodes = nodes;
+    ast->extra = check.extra;
+    ast->roots = roots;
+    ast->values = values;
+    ast->strings = strings;
+    ast->text = text;
+    ast->source = base + header->source;
+    return true;
+}
+
+const char *binaryAstString(binaryAst *ast, uint32_t string){
+    return string ? &ast->text[ast->strings[string]] : NULL;
+}
+
+dataValue binaryAstValue(binaryAst *ast, uint32_t index){
+    const flatNode *node = &ast->nodes[index];
+    if(isInlineValue((dataType)node->op)) return inlineFlatValue(node);
+
+    const binaryValue *boxed = &ast->values[node->lhs];
+    dataValue value = {0};
+    value.type = (dataType)boxed->type;
+    if(value.type == type_string) value.value.str_value = binaryAstString(ast, boxed->string);
+    else memcpy(&value.value, boxed->bits, sizeof(boxed->bits));
+    return value;
+}
+
+void closeBinaryAst(binaryAst *ast){
+    if(ast->mapped) munmap(ast->mapped, ast->mapped_size);
+    free(ast->owned);
+    memset(ast, 0, sizeof(binaryAst));
+}
+
+uint64_t hashSource(const char *src, long long length){
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(long long i = 0; i < length; i++){
+        hash ^= (unsigned char)src[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool mapEntry(const char *path, const char *src, long long length, uint64_t hash, binaryAst *ast){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0){
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return false;
+
+    if(!readBinaryAst(ast, data, size) || ast->header->parser_revision != PARSER_REVISION ||
+       ast->header->source_hash != hash || ast->header->source_length != (uint64_t)length ||
+       memcmp(ast->source, src, length) != 0){
+        munmap(data, size);
+        return false;
+    }
+    ast->mapped = data;
+    ast->mapped_size = size;
+    return true;
+}
+
+// Written under a temporary name and renamed into place, so a reader never
+// maps a partial entry.
+static void storeEntry(const char *path, const void *data, size_t size){
+    char temporary[4096];
+    if(snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)getpid()) >= (int)sizeof(temporary)) return;
+
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return;
+
+    const char *bytes = data;
+    size_t written = 0;
+    while(written < size){
+        ssize_t n = write(fd, bytes + written, size - written);
+        if(n <= 0) break;
+        written += (size_t)n;
+    }
+    if(close(fd) < 0 || written < size || rename(temporary, path) < 0) unlink(temporary);
+}
+
+typedef struct {
+    flatAst flat;
+    uint32_t *roots;
+    uint32_t root_count;
+    uint32_t root_capacity;
+    bool ok;
+} cacheBuild;
+
+static bool flattenStatement(astNode *statement, void *ctx){
+    cacheBuild *build = ctx;
+    uint32_t root = flattenAst(&build->flat, statement);
+    if(!root || !reserve((void **)&build->roots, &build->root_capacity, build->root_count + 1, sizeof(uint32_t))){
+        build->ok = false;
+        return false;
+    }
+    build->roots[build->root_count++] = root;
+    return true;
+}
+
+bool loadCachedAst(const char *directory, const char *src, long long length, binaryAst *ast){
+    uint64_t hash = hashSource(src, length);
+    char path[4096];
+    bool named = snprintf(path, sizeof(path), "%s/%016llx.ast", directory, (unsigned long long)hash) < (int)sizeof(path);
+    if(named && mapEntry(path, src, length, hash, ast)) return true;
+
+    cacheBuild build = {.ok = true};
+    initFlatAst(&build.flat);
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+    parser parser;
+    initParser(&parser, &lexer);
+    // The flattened statements refer to their names by atom.
+    parser.keep_atoms = true;
+    bool complete = parseProgramStreaming(&parser, flattenStatement, &build);
+    freeParser(&parser);
+    freeLexer(&lexer);
+
+    size_t size = 0;
+    void *data = build.ok ? writeBinaryAst(&build.flat, build.roots, build.root_count, complete, src, length, &size) : NULL;
+    freeFlatAst(&build.flat);
+    free(build.roots);
+    if(!data) return false;
+
+    if(!readBinaryAst(ast, data, size)){
+        free(data);
+        return false;
+    }
+    if(named) storeEntry(path, data, size);
+    ast->owned = data;
+    return true;
+}
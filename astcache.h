@@ -0,0 +1,112 @@
+#ifndef ASTCACHE_H
+#define ASTCACHE_H
+
+#include "flatast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk form of a flatAst, built to be walked in place once mapped. Each
+// section is found by its byte offset from the start of the file and nodes
+// name each other by index, so nothing is fixed up after loading:
+//
+//   binaryAstHeader
+//   flatNode    nodes[node_count]      laid out as in flatast.h
+//   uint32_t    extra[extra_count]
+//   uint32_t    roots[root_count]      top-level statements in source order
+//   binaryValue values[value_count]
+//   uint32_t    strings[string_count]  offset of each string in text
+//   char        text[text_bytes]       NUL-terminated strings
+//   char        source[source_length]  the input the tree was parsed from
+//
+// Nodes differ from flatAst in one way: where flatAst holds an atom, the
+// file holds a string index, since atoms only mean something inside one
+// process. String 0 stands for a missing name. lazy_body nodes hold offsets
+// into source.
+#define BINARY_AST_MAGIC "ASTB"
+#define BINARY_AST_VERSION 2
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    // 0x0102 as written. Files from a machine with another byte order or
+    // dataValue layout are rejected rather than converted.
+    uint16_t byte_order;
+    uint32_t value_size;
+    // PARSER_REVISION of the parser that built the tree.
+    uint32_t parser_revision;
+    // False if the source stopped parsing early; the tree then holds the
+    // statements before that point.
+    uint32_t complete;
+    uint32_t reserved;
+    uint64_t source_hash;
+    uint64_t source_length;
+
+    uint32_t node_count;
+    uint32_t extra_count;
+    uint32_t root_count;
+    uint32_t value_count;
+    uint32_t string_count;
+    uint32_t text_bytes;
+
+    uint64_t nodes;
+    uint64_t extra;
+    uint64_t roots;
+    uint64_t values;
+    uint64_t strings;
+    uint64_t text;
+    uint64_t source;
+} binaryAstHeader;
+
+// A boxed value. Strings are a string index; anything else is the bytes of
+// dataValue's value union.
+typedef struct {
+    uint32_t type;
+    uint32_t string;
+    unsigned char bits[sizeof(((dataValue *)0)->value)];
+} binaryValue;
+
+typedef struct {
+    const binaryAstHeader *header;
+    const flatNode *nodes;
+    const uint32_t *extra;
+    const uint32_t *roots;
+    const binaryValue *values;
+    const uint32_t *strings;
+    const char *text;
+    const char *source;
+
+    // What closeBinaryAst releases: a mapping or a malloc'd buffer.
+    void *mapped;
+    size_t mapped_size;
+    void *owned;
+} binaryAst;
+
+// Serializes the trees under roots, which were parsed from src. Returns a
+// malloc'd buffer of *size bytes, or NULL if memory ran out.
+void *writeBinaryAst(flatAst *ast, const uint32_t *roots, uint32_t root_count, bool complete, const char *src, long long length, size_t *size);
+// Points ast into the size bytes at data without copying; data must outlive
+// ast. Returns false unless the header matches this build and every section,
+// node, index and string lies in bounds, so a damaged or foreign file is
+// rejected instead of read out of bounds. Every child index is below its
+// parent's, so walks over a checked tree always end.
+bool readBinaryAst(binaryAst *ast, const void *data, size_t size);
+// NULL for string 0.
+const char *binaryAstString(binaryAst *ast, uint32_t string);
+// The value of a value node. String values point into the text section.
+dataValue binaryAstValue(binaryAst *ast, uint32_t index);
+void closeBinaryAst(binaryAst *ast);
+
+// 64-bit FNV-1a of the source bytes.
+uint64_t hashSource(const char *src, long long length);
+
+// Maps the tree of src from directory/<hash>.ast, so an unchanged input is
+// neither lexed nor parsed. An entry is only used if its copy of the source
+// equals src byte for byte and it was built by this PARSER_REVISION, so hash
+// collisions and parser changes cost a parse, never a wrong tree. Otherwise
+// src is parsed and the entry written first; if it cannot be written the
+// tree is still returned from memory. src[length] must be '\0'. Returns
+// false if memory ran out or the new entry does not pass readBinaryAst.
+bool loadCachedAst(const char *directory, const char *src, long long length, binaryAst *ast);
+
+#endif
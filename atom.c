@@ -0,0 +1,297 @@
+#include "atom.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define ATOM_CHUNK_SIZE (64 * 1024)
+#define ATOM_PAGE_BITS 12
+#define ATOM_PAGE_SIZE (1 << ATOM_PAGE_BITS)
+#define ATOM_PAGES 4096
+
+// Names are stored in chunks right after their header, so the atom and
+// length of a canonical pointer are found just before it.
+typedef struct {
+    atom id;
+    uint32_t length;
+} atomHeader;
+
+typedef struct atomChunk {
+    struct atomChunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} atomChunk;
+
+typedef struct {
+    uint32_t hash;
+    _Atomic atom id;
+    const char *name;
+} atomSlot;
+
+// Lookups read the current table without the lock. Inserts and growth happen
+// under it; a slot's id is published last, and a grown table replaces the old
+// one only once it is complete. Old tables stay allocated until freeAtoms, so
+// a reader still probing one is never left with a dangling pointer.
+typedef struct atomTable {
+    struct atomTable *previous;
+    uint32_t capacity;
+    atomSlot slots[];
+} atomTable;
+
+// Identifiers and string literals are interned into separate pools, so the
+// atoms of names stay dense.
+typedef struct {
+    pthread_mutex_t lock;
+    _Atomic(atomTable *) table;
+    uint32_t count;
+    atomChunk *chunks;
+
+    // Read without the lock too. A page is filled in before any of its atoms
+    // is published and never moves afterwards.
+    const char **pages[ATOM_PAGES];
+} internPool;
+
+static internPool names = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static internPool literals = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint32_t hashName(const char *name, size_t length){
+    uint64_t hash = length * 0x9e3779b97f4a7c15ull;
+    while(length >= 8){
+        uint64_t word;
+        memcpy(&word, name, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        name += 8;
+        length -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, name, length);
+    hash = (hash ^ tail) * 0xff51afd7ed558ccdull;
+    return (uint32_t)(hash >> 32);
+}
+
+static atomHeader *headerOf(const char *name){
+    return (atomHeader *)(name - sizeof(atomHeader));
+}
+
+static atomTable *growTable(internPool *pool, atomTable *current){
+    uint32_t capacity = current ? current->capacity * 2 : 1024;
+    atomTable *grown = calloc(1, sizeof(atomTable) + capacity * sizeof(atomSlot));
+    if(!grown) return NULL;
+
+    grown->previous = current;
+    grown->capacity = capacity;
+    for(uint32_t i = 0; current && i < current->capacity; i++){
+        atom id = atomic_load_explicit(&current->slots[i].id, memory_order_relaxed);
+        if(!id) continue;
+
+        uint32_t index = current->slots[i].hash & (capacity - 1);
+        while(atomic_load_explicit(&grown->slots[index].id, memory_order_relaxed)) index = (index + 1) & (capacity - 1);
+        grown->slots[index].hash = current->slots[i].hash;
+        grown->slots[index].name = current->slots[i].name;
+        atomic_store_explicit(&grown->slots[index].id, id, memory_order_relaxed);
+    }
+    atomic_store_explicit(&pool->table, grown, memory_order_release);
+    return grown;
+}
+
+static char *storeName(internPool *pool, const char *name, size_t length, atom id){
+    size_t needed = (sizeof(atomHeader) + length + 1 + sizeof(atom) - 1) & ~(sizeof(atom) - 1);
+
+    if(!pool->chunks || pool->chunks->size - pool->chunks->used < needed){
+        size_t size = needed > ATOM_CHUNK_SIZE ? needed : ATOM_CHUNK_SIZE;
+        atomChunk *chunk = malloc(sizeof(atomChunk) + size);
+        if(!chunk) return NULL;
+
+        chunk->next = pool->chunks;
+        chunk->used = 0;
+        chunk->size = size;
+        pool->chunks = chunk;
+    }
+
+    atomHeader *header = (atomHeader *)&pool->chunks->data[pool->chunks->used];
+    header->id = id;
+    header->length = (uint32_t)length;
+    char *text = (char *)(header + 1);
+    memcpy(text, name, length);
+    text[length] = '\0';
+    pool->chunks->used += needed;
+    return text;
+}
+
+static atom findAtom(atomTable *current, const char *name, size_t length, uint32_t hash){
+    uint32_t index = hash & (current->capacity - 1);
+    while(1){
+        atom id = atomic_load_explicit(&current->slots[index].id, memory_order_acquire);
+        if(!id) return 0;
+
+        if(current->slots[index].hash == hash){
+            const char *existing = current->slots[index].name;
+            if(headerOf(existing)->length == length && memcmp(existing, name, length) == 0) return id;
+        }
+        index = (index + 1) & (current->capacity - 1);
+    }
+}
+
+static atom insertLocked(internPool *pool, const char *name, size_t length, uint32_t hash){
+    atomTable *current = atomic_load_explicit(&pool->table, memory_order_relaxed);
+    if(current){
+        atom id = findAtom(current, name, length, hash);
+        if(id) return id;
+    }
+
+    atom id = pool->count + 1;
+    if(id >= ATOM_PAGES * ATOM_PAGE_SIZE || length > UINT32_MAX) return 0;
+    if(!current || (pool->count + 1) * 2 > current->capacity){
+        current = growTable(pool, current);
+        if(!current) return 0;
+    }
+
+    const char ***page = &pool->pages[id >> ATOM_PAGE_BITS];
+    if(!*page){
+        *page = malloc(ATOM_PAGE_SIZE * sizeof(const char *));
+        if(!*page) return 0;
+    }
+
+    char *text = storeName(pool, name, length, id);
+    if(!text) return 0;
+    (*page)[id & (ATOM_PAGE_SIZE - 1)] = text;
+    pool->count++;
+
+    uint32_t index = hash & (current->capacity - 1);
+    while(atomic_load_explicit(&current->slots[index].id, memory_order_relaxed)) index = (index + 1) & (current->capacity - 1);
+    current->slots[index].hash = hash;
+    current->slots[index].name = text;
+    atomic_store_explicit(&current->slots[index].id, id, memory_order_release);
+    return id;
+}
+
+static atom intern(internPool *pool, const char *name, size_t length){
+    uint32_t hash = hashName(name, length);
+
+    atomTable *current = atomic_load_explicit(&pool->table, memory_order_acquire);
+    if(current){
+        atom id = findAtom(current, name, length, hash);
+        if(id) return id;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    atom id = insertLocked(pool, name, length, hash);
+    pthread_mutex_unlock(&pool->lock);
+    return id;
+}
+
+static const char *poolName(internPool *pool, atom id){
+    if(!id) return NULL;
+    return pool->pages[id >> ATOM_PAGE_BITS][id & (ATOM_PAGE_SIZE - 1)];
+}
+
+static void freePool(internPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    while(pool->chunks){
+        atomChunk *next = pool->chunks->next;
+        free(pool->chunks);
+        pool->chunks = next;
+    }
+    for(int i = 0; i < ATOM_PAGES; i++){
+        free(pool->pages[i]);
+        pool->pages[i] = NULL;
+    }
+    atomTable *current = atomic_exchange(&pool->table, NULL);
+    while(current){
+        atomTable *previous = current->previous;
+        free(current);
+        current = previous;
+    }
+    pool->count = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static poolMark markPool(internPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    poolMark mark = {pool->count, pool->chunks, pool->chunks ? pool->chunks->used : 0};
+    pthread_mutex_unlock(&pool->lock);
+    return mark;
+}
+
+// Takes id out of its probe sequence, shifting later entries of the cluster
+// back so lookups for them still find them.
+static void removeSlot(atomTable *current, uint32_t hash, atom id){
+    uint32_t mask = current->capacity - 1;
+    uint32_t hole = hash & mask;
+    while(atomic_load_explicit(&current->slots[hole].id, memory_order_relaxed) != id) hole = (hole + 1) & mask;
+
+    for(uint32_t next = (hole + 1) & mask; ; next = (next + 1) & mask){
+        atom moved = atomic_load_explicit(&current->slots[next].id, memory_order_relaxed);
+        if(!moved) break;
+
+        uint32_t home = current->slots[next].hash & mask;
+        if(((next - home) & mask) < ((next - hole) & mask)) continue;
+        current->slots[hole].hash = current->slots[next].hash;
+        current->slots[hole].name = current->slots[next].name;
+        atomic_store_explicit(&current->slots[hole].id, moved, memory_order_relaxed);
+        hole = next;
+    }
+    atomic_store_explicit(&current->slots[hole].id, 0, memory_order_relaxed);
+}
+
+static void releasePool(internPool *pool, poolMark *mark){
+    pthread_mutex_lock(&pool->lock);
+    atomTable *current = atomic_load_explicit(&pool->table, memory_order_relaxed);
+    for(atom id = pool->count; id > mark->count; id--){
+        const char *name = poolName(pool, id);
+        removeSlot(current, hashName(name, headerOf(name)->length), id);
+    }
+    pool->count = mark->count;
+
+    while(pool->chunks != mark->chunk){
+        atomChunk *next = pool->chunks->next;
+        free(pool->chunks);
+        pool->chunks = next;
+    }
+    if(pool->chunks) pool->chunks->used = mark->used;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+atom internAtom(const char *name, size_t length){
+    return intern(&names, name, length);
+}
+
+const char *internName(const char *name, size_t length){
+    return poolName(&names, intern(&names, name, length));
+}
+
+const char *atomName(atom id){
+    return poolName(&names, id);
+}
+
+atom nameAtom(const char *name){
+    return name ? headerOf(name)->id : 0;
+}
+
+size_t nameLength(const char *name){
+    return headerOf(name)->length;
+}
+
+const char *internLiteral(const char *text, size_t length){
+    return poolName(&literals, intern(&literals, text, length));
+}
+
+void freeAtoms(void){
+    freePool(&names);
+    freePool(&literals);
+}
+
+atomMark markAtoms(void){
+    return (atomMark){markPool(&names), markPool(&literals)};
+}
+
+uint32_t atomsSince(atomMark mark){
+    return names.count - mark.names.count + literals.count - mark.literals.count;
+}
+
+void releaseAtoms(atomMark mark){
+    releasePool(&names, &mark.names);
+    releasePool(&literals, &mark.literals);
+}
@@ -0,0 +1,47 @@
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Every distinct identifier is stored once and named by a 32-bit atom.
+// Atom 0 is never handed out. The canonical string of an atom never moves,
+// so names can be compared by atom or by pointer. The table is shared by all
+// threads and lives until freeAtoms.
+typedef uint32_t atom;
+
+atom internAtom(const char *name, size_t length);
+const char *internName(const char *name, size_t length);
+const char *atomName(atom id);
+// Only valid for pointers returned by internName or atomName.
+atom nameAtom(const char *name);
+// Also valid for pointers returned by internLiteral.
+size_t nameLength(const char *name);
+
+// String literals get a pool of their own: the decoded text is stored once,
+// NUL-terminated, and equal literals share one pointer.
+const char *internLiteral(const char *text, size_t length);
+void freeAtoms(void);
+
+// Everything interned after a mark, names and literals alike, can be dropped
+// again with releaseAtoms, so handling a long input piece by piece does not
+// keep every name it ever saw. Released names and literals must no longer be
+// used and their atoms are handed out again. Neither call may overlap with
+// any other use of the tables on another thread.
+typedef struct {
+    uint32_t count;
+    struct atomChunk *chunk;
+    size_t used;
+} poolMark;
+
+typedef struct {
+    poolMark names;
+    poolMark literals;
+} atomMark;
+
+atomMark markAtoms(void);
+// How many names and literals were interned since mark.
+uint32_t atomsSince(atomMark mark);
+void releaseAtoms(atomMark mark);
+
+#endif
@@ -0,0 +1,84 @@
+// AST cache: parsing and storing an entry against mapping it back.
+// cc -O2 -I.. cache.c ../lexer.c ../parser.c ../ast.c ../atom.c ../flatast.c ../astcache.c -o cache -lpthread && ./cache file [rounds]
+#include "astcache.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Touches every node, name and value in place.
+static size_t visitBinary(binaryAst *ast){
+    size_t sum = 0;
+    for(uint32_t i = 1; i < ast->header->node_count; i++){
+        const flatNode *node = &ast->nodes[i];
+        sum += node->type * 31u + 1;
+        if(node->type == identifier_node) sum += binaryAstString(ast, node->lhs)[0];
+        else if(node->type == value_node) sum += binaryAstValue(ast, i).type;
+    }
+    return sum;
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: cache file [rounds]\n");
+        return 1;
+    }
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+
+    lexer lexer;
+    if(!initLexerFromFile(&lexer, argv[1])){
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    char directory[] = "/tmp/astcacheXXXXXX";
+    if(!mkdtemp(directory)) return 1;
+    char path[sizeof(directory) + 32];
+    snprintf(path, sizeof(path), "%s/%016llx.ast", directory, (unsigned long long)hashSource(lexer.src, lexer.length));
+
+    double cold = 0;
+    double warm = 0;
+    size_t cold_sum = 0;
+    size_t warm_sum = 0;
+    size_t entry = 0;
+    binaryAst ast;
+    for(int r = 0; r < rounds; r++){
+        unlink(path);
+        double start = now();
+        if(!loadCachedAst(directory, lexer.src, lexer.length, &ast)) return 1;
+        double elapsed = now() - start;
+        if(r == 0 || elapsed < cold) cold = elapsed;
+        cold_sum = visitBinary(&ast);
+        closeBinaryAst(&ast);
+        freeAtoms();
+
+        start = now();
+        if(!loadCachedAst(directory, lexer.src, lexer.length, &ast)) return 1;
+        elapsed = now() - start;
+        if(!ast.mapped){
+            fprintf(stderr, "entry was not stored in %s\n", directory);
+            return 1;
+        }
+        if(r == 0 || elapsed < warm) warm = elapsed;
+        warm_sum = visitBinary(&ast);
+        entry = ast.mapped_size;
+        closeBinaryAst(&ast);
+    }
+    unlink(path);
+    rmdir(directory);
+
+    printf("%.1f MB source, %.1f MB entry, %s\n", lexer.length / 1e6, entry / 1e6, cold_sum == warm_sum ? "checksums match" : "CHECKSUM MISMATCH");
+    printf("miss (parse + store) %8.2f ms\n", cold * 1e3);
+    printf("hit (map + check)    %8.2f ms  %.1fx\n", warm * 1e3, cold / warm);
+
+    freeLexer(&lexer);
+    return 0;
+}
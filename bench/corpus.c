@@ -0,0 +1,140 @@
+// Deterministic synthetic corpus generator.
+// corpus <kind> [bytes] [seed] > out.astra
+// kinds: functions expressions arrays comments strings types mixed
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int seed = 12345;
+static size_t written;
+
+static unsigned int nextRandom(){
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static void emit(const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    if(n > 0) written += n;
+}
+
+static const char *types[] = {"int", "long", "double", "bool", "string", "uint", "float", "short"};
+static const char *binary_ops[] = {"+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "&&", "||", "==", "!=", "<", ">=" };
+static const char *words[] = {"alpha", "beta", "gamma", "delta", "file", "path", "error", "value", "count", "name"};
+
+#define PICK(table) table[nextRandom() % (sizeof(table) / sizeof(table[0]))]
+
+static void leaf(){
+    switch(nextRandom() % 4){
+        case 0: emit("%u", nextRandom()); break;
+        case 1: emit("v%u", nextRandom() % 64); break;
+        case 2: emit("f%u(v%u)", nextRandom() % 16, nextRandom() % 64); break;
+        default: emit("p%u.%s", nextRandom() % 8, PICK(words)); break;
+    }
+}
+
+static void expression(int depth){
+    if(depth == 0 || nextRandom() % 5 == 0){
+        leaf();
+        return;
+    }
+    emit("(");
+    expression(depth - 1);
+    emit(" %s ", PICK(binary_ops));
+    expression(depth - 1);
+    emit(")");
+}
+
+static void function(unsigned int id){
+    emit("fun f%u(a: %s, b: %s) -> int {\n", id, PICK(types), PICK(types));
+    emit("    x: int = a * %u + b;\n", nextRandom() % 100);
+    emit("    if (x > %u) { x -= 1; } else { x += b; }\n", nextRandom() % 1000);
+    emit("    for (i: int = 0; i < %u; i++) { x = g(x, i); }\n", nextRandom() % 50);
+    emit("    return x;\n}\n");
+}
+
+static void expressions(unsigned int id){
+    emit("fun e%u() -> long {\n    return ", id);
+    expression(4 + nextRandom() % 8);
+    emit(";\n}\n");
+}
+
+static void array(unsigned int id){
+    int count = 200 + nextRandom() % 1800;
+    emit("fun t%u() -> int {\n    table: int[%d] = [", id, count);
+    for(int i = 0; i < count; i++){
+        emit(i % 16 == 15 ? "%u,\n        " : "%u, ", nextRandom());
+    }
+    emit("%u];\n    return count(table);\n}\n", nextRandom());
+}
+
+static void comments(unsigned int id){
+    int lines = 2 + nextRandom() % 8;
+    for(int i = 0; i < lines; i++) emit("// %s %s: note %u about %s\n", PICK(words), PICK(words), nextRandom(), PICK(words));
+    emit("/*\n");
+    for(int i = 0; i < lines; i++) emit(" * %s %s %u \"quoted\" text\n", PICK(words), PICK(words), nextRandom());
+    emit(" */\n");
+    emit("fun c%u() -> int { return %u; } // trailing\n", id, nextRandom());
+}
+
+static void strings(unsigned int id){
+    emit("fun s%u() -> string {\n", id);
+    int count = 4 + nextRandom() % 8;
+    for(int i = 0; i < count; i++){
+        switch(nextRandom() % 3){
+            case 0: emit("    m%d: string = \"%s %s\";\n", i, PICK(words), PICK(words)); break;
+            case 1: emit("    m%d: string = \"%s:\\t%s\\n\";\n", i, PICK(words), PICK(words)); break;
+            default: emit("    m%d: string = \"%s %u %s %s %s\";\n", i, PICK(words), nextRandom(), PICK(words), PICK(words), PICK(words)); break;
+        }
+    }
+    emit("    return m0;\n}\n");
+}
+
+static void declarations(unsigned int id){
+    emit("struct S%u { x: int; y: %s; next: S%u*; }\n", id, PICK(types), id);
+    emit("union U%u { a: int; b: %s; }\n", id, PICK(types));
+    emit("enum E%u { A%u, B%u = %u, C%u }\n", id, id, id, nextRandom() % 100, id);
+    emit("typedef S%u T%u;\n", id, id);
+    emit("trait R%u { fun get(self) -> int; }\n", id);
+    emit("impl R%u for S%u { fun get(self) -> int { return self.x + self.next->y; } }\n", id, id);
+}
+
+typedef void (*generator)(unsigned int id);
+
+static const struct {
+    const char *name;
+    generator generate;
+} kinds[] = {
+    {"functions", function},
+    {"expressions", expressions},
+    {"arrays", array},
+    {"comments", comments},
+    {"strings", strings},
+    {"types", declarations},
+};
+
+int main(int argc, char **argv){
+    const char *kind = argc > 1 ? argv[1] : "mixed";
+    size_t bytes = argc > 2 ? strtoul(argv[2], NULL, 10) : 8 << 20;
+    seed = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 12345;
+
+    int count = sizeof(kinds) / sizeof(kinds[0]);
+    int selected = -1;
+    for(int i = 0; i < count; i++){
+        if(strcmp(kinds[i].name, kind) == 0) selected = i;
+    }
+    if(selected < 0 && strcmp(kind, "mixed") != 0){
+        fprintf(stderr, "unknown kind %s\n", kind);
+        return 1;
+    }
+
+    for(unsigned int id = 0; written < bytes; id++){
+        int current = selected >= 0 ? selected : (int)(id % count);
+        kinds[current].generate(id);
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+// Pointer AST against the flat AST: bytes per node and a full traversal.
+// cc -O2 -I.. flat.c ../lexer.c ../parser.c ../ast.c ../atom.c ../flatast.c -o flat -lpthread && ./flat file [rounds]
+#include "parser.h"
+#include "flatast.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *readFile(const char *path, long long *length){
+    FILE *file = fopen(path, "rb");
+    if(!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+
+    char *src = malloc(*length + 1);
+    if(src && fread(src, 1, *length, file) != (size_t)*length){
+        free(src);
+        src = NULL;
+    }
+    fclose(file);
+    if(src) src[*length] = '\0';
+    return src;
+}
+
+// Both traversals compute the same checksum from every node's type.
+static size_t visitTree(astNode *node){
+    if(!node) return 0;
+
+    size_t sum = node->type * 31u + 1;
+    switch(node->type){
+        case assignment_node:
+            sum += visitTree(node->assignment.left) + visitTree(node->assignment.right);
+            break;
+        case define_node:
+            sum += visitTree(node->define.type) + visitTree(node->define.initializer);
+            break;
+        case pointer_node:
+            sum += visitTree(node->pointer.ptr);
+            break;
+        case body_node:
+            for(int i = 0; i < node->body.elements_count; i++) sum += visitTree(node->body.elements[i]);
+            break;
+        case array_node:
+            sum += visitTree(node->array.type) + visitTree(node->array.size) + visitTree(node->array.elements);
+            break;
+        case array_access_node:
+            sum += visitTree(node->array_access.array) + visitTree(node->array_access.index);
+            break;
+        case function_node:
+            sum += visitTree(node->function.return_type) + visitTree(node->function.params) + visitTree(node->function.body);
+            break;
+        case call_node:
+            sum += visitTree(node->call.identifier) + visitTree(node->call.args);
+            break;
+        case data_operation_node:
+            sum += visitTree(node->operation.left) + visitTree(node->operation.right);
+            break;
+        case if_node:
+            sum += visitTree(node->if_stmt.condition) + visitTree(node->if_stmt.then_branch) + visitTree(node->if_stmt.else_branch);
+            break;
+        case switch_node:
+            sum += visitTree(node->switch_stmt.condition) + visitTree(node->switch_stmt.body);
+            break;
+        case case_node:
+            sum += visitTree(node->case_stmt.value);
+            break;
+        case for_node:
+            sum += visitTree(node->for_stmt.initializer) + visitTree(node->for_stmt.condition) + visitTree(node->for_stmt.increment) + visitTree(node->for_stmt.then_branch);
+            break;
+        case while_node:
+            sum += visitTree(node->while_stmt.condition) + visitTree(node->while_stmt.then_branch);
+            break;
+        case do_while_node:
+            sum += visitTree(node->do_while_stmt.body) + visitTree(node->do_while_stmt.condition);
+            break;
+        case return_node:
+            sum += visitTree(node->return_stmt.value);
+            break;
+        case import_node:
+            sum += visitTree(node->import_stmt.identifier);
+            break;
+        case struct_node:
+            sum += visitTree(node->struct_stmt.body);
+            break;
+        case impl_node:
+            sum += visitTree(node->impl_stmt.body);
+            break;
+        case trait_node:
+            sum += visitTree(node->trait_stmt.body);
+            break;
+        case dot_access_node:
+            sum += visitTree(node->dot_access.object);
+            break;
+        case arrow_access_node:
+            sum += visitTree(node->arrow_access.object);
+            break;
+        case enum_node:
+            sum += visitTree(node->enum_stmt.body);
+            break;
+        case union_node:
+            sum += visitTree(node->union_stmt.body);
+            break;
+        case sizeof_node:
+            sum += visitTree(node->sizeof_expr.operand);
+            break;
+        case typeof_node:
+            sum += visitTree(node->typeof_expr.operand);
+            break;
+        case cast_node:
+            sum += visitTree(node->cast_expr.type) + visitTree(node->cast_expr.operand);
+            break;
+        case typedef_node:
+            sum += visitTree(node->typedef_stmt.type);
+            break;
+        default:
+            break;
+    }
+    return sum;
+}
+
+// The same walk by index, for when order matters and a scan will not do.
+static size_t visitFlat(flatAst *ast, uint32_t index){
+    if(!index) return 0;
+
+    flatNode *node = &ast->nodes[index];
+    uint32_t *extra = ast->extra;
+    size_t sum = node->type * 31u + 1;
+    switch(node->type){
+        case identifier_node:
+        case value_node:
+        case default_node:
+        case break_node:
+        case continue_node:
+        case lazy_body_node:
+            break;
+        case define_node:
+            sum += visitFlat(ast, node->lhs) + visitFlat(ast, extra[node->rhs + 1]);
+            break;
+        case body_node:
+            for(uint32_t i = 0; i < node->rhs; i++) sum += visitFlat(ast, extra[node->lhs + i]);
+            break;
+        case array_node:
+            sum += visitFlat(ast, extra[node->lhs]) + visitFlat(ast, extra[node->lhs + 1]) + visitFlat(ast, extra[node->lhs + 2]);
+            break;
+        case function_node:
+            sum += visitFlat(ast, extra[node->lhs + 1]) + visitFlat(ast, extra[node->lhs + 2]) + visitFlat(ast, extra[node->lhs + 3]);
+            break;
+        case if_node:
+            sum += visitFlat(ast, node->lhs) + visitFlat(ast, extra[node->rhs]) + visitFlat(ast, extra[node->rhs + 1]);
+            break;
+        case for_node:
+            sum += visitFlat(ast, extra[node->lhs]) + visitFlat(ast, extra[node->lhs + 1]) + visitFlat(ast, extra[node->lhs + 2]) + visitFlat(ast, extra[node->lhs + 3]);
+            break;
+        case impl_node:
+        case struct_node:
+        case trait_node:
+        case enum_node:
+        case union_node:
+            sum += visitFlat(ast, node->rhs);
+            break;
+        case dot_access_node:
+        case arrow_access_node:
+        case typedef_node:
+        case pointer_node:
+        case case_node:
+        case return_node:
+        case import_node:
+        case sizeof_node:
+        case typeof_node:
+            sum += visitFlat(ast, node->lhs);
+            break;
+        default:
+            sum += visitFlat(ast, node->lhs) + visitFlat(ast, node->rhs);
+            break;
+    }
+    return sum;
+}
+
+static size_t scanFlat(flatAst *ast){
+    size_t sum = 0;
+    for(uint32_t i = 1; i < ast->node_count; i++) sum += ast->nodes[i].type * 31u + 1;
+    return sum;
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: flat file [rounds]\n");
+        return 1;
+    }
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    long long length;
+    char *src = readFile(argv[1], &length);
+    if(!src){
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    // Lex once first so the atom table and literal pool are already filled
+    // and only nodes show up in the heap delta below.
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+    while(nextToken(&lexer).type != eof_token);
+    freeLexer(&lexer);
+
+    size_t count = 0;
+    size_t capacity = 1024;
+    astNode **roots = malloc(capacity * sizeof(astNode *));
+    if(!roots) return 1;
+
+    size_t heap = mallinfo2().uordblks;
+    initLexerBorrowed(&lexer, src, length);
+    parser parser;
+    initParser(&parser, &lexer);
+    while(1){
+        astNode *node = parseStatement(&parser);
+        if(!node) break;
+        if(count == capacity){
+            capacity *= 2;
+            astNode **grown = realloc(roots, capacity * sizeof(astNode *));
+            if(!grown) return 1;
+            roots = grown;
+        }
+        roots[count++] = node;
+    }
+    freeParser(&parser);
+    freeLexer(&lexer);
+    heap = mallinfo2().uordblks - heap - capacity * sizeof(astNode *);
+
+    flatAst flat;
+    initFlatAst(&flat);
+    uint32_t *roots_flat = malloc(count * sizeof(uint32_t));
+    if(!roots_flat) return 1;
+    double start = now();
+    for(size_t i = 0; i < count; i++){
+        roots_flat[i] = flattenAst(&flat, roots[i]);
+        if(!roots_flat[i]) return 1;
+    }
+    double flatten_time = now() - start;
+
+    size_t nodes = flat.node_count - 1;
+    double tree_best = 0;
+    double walk_best = 0;
+    double flat_best = 0;
+    size_t tree_sum = 0;
+    size_t walk_sum = 0;
+    size_t flat_sum = 0;
+    for(int r = 0; r < rounds; r++){
+        start = now();
+        tree_sum = 0;
+        for(size_t i = 0; i < count; i++) tree_sum += visitTree(roots[i]);
+        double elapsed = now() - start;
+        if(r == 0 || elapsed < tree_best) tree_best = elapsed;
+
+        start = now();
+        walk_sum = 0;
+        for(size_t i = 0; i < count; i++) walk_sum += visitFlat(&flat, roots_flat[i]);
+        elapsed = now() - start;
+        if(r == 0 || elapsed < walk_best) walk_best = elapsed;
+
+        start = now();
+        flat_sum = scanFlat(&flat);
+        elapsed = now() - start;
+        if(r == 0 || elapsed < flat_best) flat_best = elapsed;
+    }
+
+    bool match = tree_sum == walk_sum && tree_sum == flat_sum;
+    printf("%zu statements, %zu nodes, %s\n", count, nodes, match ? "checksums match" : "CHECKSUM MISMATCH");
+    printf("pointer AST  %6.1f bytes/node incl. malloc   walk %7.2f Mnode/s\n", (double)heap / nodes, nodes / tree_best / 1e6);
+    printf("flat AST     %6.1f bytes/node                 walk %7.2f Mnode/s, scan %7.2f Mnode/s\n", (double)flatAstBytes(&flat) / nodes, nodes / walk_best / 1e6, nodes / flat_best / 1e6);
+    printf("             %zu extra words, %zu boxed values, flattened at %.2f Mnode/s\n", (size_t)flat.extra_count, (size_t)flat.value_count, nodes / flatten_time / 1e6);
+
+    for(size_t i = 0; i < count; i++) freeAst(roots[i]);
+    free(roots);
+    free(roots_flat);
+    freeFlatAst(&flat);
+    freeAtoms();
+    free(src);
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Identifier/keyword classification microbenchmark.
+// cc -O2 -I.. identifiers.c ../lexer.c ../atom.c -o identifiers -lpthread && ./identifiers
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *keywords[] = {
+    "if", "else", "while", "for", "return", "int", "long", "const",
+    "struct", "fun", "self", "string", "static", "typedef", "continue"
+};
+
+static unsigned int seed = 12345;
+
+static unsigned int nextRandom(){
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static char *generate(size_t count, size_t *out_len){
+    char *src = malloc(count * 16 + 1);
+    if(!src) return NULL;
+
+    size_t len = 0;
+    for(size_t i = 0; i < count; i++){
+        if(nextRandom() % 5 == 0){
+            const char *kw = keywords[nextRandom() % (sizeof(keywords) / sizeof(keywords[0]))];
+            size_t kw_len = strlen(kw);
+            memcpy(&src[len], kw, kw_len);
+            len += kw_len;
+        } else {
+            int ident_len = 3 + nextRandom() % 10;
+            for(int j = 0; j < ident_len; j++){
+                unsigned int r = nextRandom() % 30;
+                if(j > 0 && r >= 26) src[len++] = r == 26 ? '_' : (char)('0' + r - 27);
+                else src[len++] = (char)('a' + r % 26);
+            }
+        }
+        src[len++] = (i % 8 == 7) ? '\n' : ' ';
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    size_t len;
+    char *src = generate(count, &len);
+    if(!src) return 1;
+
+    double best = 0;
+    size_t idents = 0;
+    for(int r = 0; r < rounds; r++){
+        lexer lexer;
+        initLexer(&lexer, src);
+
+        double start = now();
+        idents = 0;
+        while(1){
+            token t = nextToken(&lexer);
+            if(t.type == eof_token) break;
+            idents++;
+            freeToken(&t);
+        }
+        double elapsed = now() - start;
+        freeLexer(&lexer);
+
+        double rate = idents / elapsed;
+        if(rate > best) best = rate;
+    }
+
+    printf("%zu identifiers, %.1f MB input\n", idents, len / 1e6);
+    printf("best of %d: %.2f M identifiers/s\n", rounds, best / 1e6);
+    free(src);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Numeric literal throughput on literal-dense data tables.
+// cc -O2 -I.. numbers.c ../lexer.c ../atom.c -o numbers -lpthread && ./numbers [rows] [rounds]
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned int seed = 12345;
+
+static unsigned int nextRandom(){
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static int appendLiteral(char *dst){
+    unsigned long long wide = ((unsigned long long)nextRandom() << 30) | ((unsigned long long)nextRandom() << 15) | nextRandom();
+
+    switch(nextRandom() % 6){
+        case 0: return sprintf(dst, "%u", nextRandom());
+        case 1: return sprintf(dst, "0x%llx", wide);
+        case 2: return sprintf(dst, "%llu", wide * wide);
+        case 3: return sprintf(dst, "0b%u%u%u%u%u%u%u%u", nextRandom() & 1, nextRandom() & 1, nextRandom() & 1, nextRandom() & 1, nextRandom() & 1, nextRandom() & 1, nextRandom() & 1, nextRandom() & 1);
+        case 4: return sprintf(dst, "%u.%u", nextRandom(), nextRandom());
+        default: return sprintf(dst, "%llu.%llu", wide, wide * 7919);
+    }
+}
+
+static char *generate(size_t rows, size_t *out_len){
+    char *src = malloc(rows * 16 * 48 + 64);
+    if(!src) return NULL;
+
+    size_t len = 0;
+    for(size_t i = 0; i < rows; i++){
+        len += sprintf(&src[len], "row%zu = {", i);
+        for(int j = 0; j < 16; j++){
+            len += appendLiteral(&src[len]);
+            src[len++] = j == 15 ? '}' : ',';
+        }
+        len += sprintf(&src[len], ";\n");
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+    size_t rows = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    size_t len;
+    char *src = generate(rows, &len);
+    if(!src) return 1;
+
+    double best = 0;
+    size_t literals = 0;
+    for(int r = 0; r < rounds; r++){
+        lexer lexer;
+        initLexerBorrowed(&lexer, src, len);
+
+        double start = now();
+        literals = 0;
+        while(1){
+            token t = nextToken(&lexer);
+            if(t.type == eof_token) break;
+            if(t.type >= short_literal_token && t.type <= long_double_literal_token) literals++;
+        }
+        double elapsed = now() - start;
+        freeLexer(&lexer);
+
+        if(best == 0 || elapsed < best) best = elapsed;
+    }
+
+    printf("%zu literals, %.1f MB input\n", literals, len / 1e6);
+    printf("best of %d: %.1f MB/s, %.2f M literals/s\n", rounds, len / best / 1e6, literals / best / 1e6);
+    free(src);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Operator scanning on operator-dense input.
+// cc -O2 -I.. operators.c ../lexer.c ../atom.c -o operators -lpthread && ./operators [count] [rounds]
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *operators[] = {
+    "+", "++", "+=", "-", "--", "-=", "->", "*", "*=", "/", "/=", "%", "%=",
+    "=", "==", "!", "!=", ">", ">>", ">>=", ">=", "<", "<<", "<<=", "<=",
+    "&", "&&", "&=", "|", "||", "|=", "^", "^=", "~", "(", ")", "[", "]",
+    "{", "}", ",", ".", "...", ";", ":"
+};
+
+static unsigned int seed = 12345;
+
+static unsigned int nextRandom(){
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+// Space-separated operators, every fourth one or so after a one-letter
+// operand, so nearly every token goes through the operator path.
+static char *generate(size_t count, size_t *out_len){
+    char *src = malloc(count * 5 + 1);
+    if(!src) return NULL;
+
+    size_t len = 0;
+    for(size_t i = 0; i < count; i++){
+        if(nextRandom() % 4 == 0){
+            src[len++] = (char)('a' + nextRandom() % 26);
+        }
+        const char *op = operators[nextRandom() % (sizeof(operators) / sizeof(operators[0]))];
+        size_t op_len = strlen(op);
+        memcpy(&src[len], op, op_len);
+        len += op_len;
+        src[len++] = (i % 16 == 15) ? '\n' : ' ';
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    size_t len;
+    char *src = generate(count, &len);
+    if(!src) return 1;
+
+    double best = 0;
+    size_t ops = 0;
+    for(int r = 0; r < rounds; r++){
+        lexer lexer;
+        initLexerBorrowed(&lexer, src, len);
+
+        double start = now();
+        ops = 0;
+        while(1){
+            token t = nextToken(&lexer);
+            if(t.type == eof_token) break;
+            if(t.type != identifier_token) ops++;
+        }
+        double elapsed = now() - start;
+        freeLexer(&lexer);
+
+        if(best == 0 || elapsed < best) best = elapsed;
+    }
+
+    printf("%zu operators, %.1f MB input\n", ops, len / 1e6);
+    printf("best of %d: %.1f MB/s, %.2f M operators/s\n", rounds, len / best / 1e6, ops / best / 1e6);
+    free(src);
+    freeAtoms();
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Parallel lexing and parsing scaling benchmark.
+// cc -O2 -I.. parallel.c ../lexer.c ../parser.c ../ast.c ../atom.c ../flatast.c -o parallel -lpthread && ./parallel [file] [max threads] [rounds]
+#include "parser.h"
+#include "flatast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *lines[] = {
+    "fun compute(a: int, b: long) -> long {\n",
+    "    total: long = a * 31 + (2 << b) - 0x7f;\n",
+    "    name: string = \"value with \\\"escapes\\\" inside\";\n",
+    "    // line comment with \"quotes\" and /* markers */\n",
+    "    /* block comment\n       spanning \"lines\" */\n",
+    "    if(total >= 100 && b != 0){ total += 1.5; }\n",
+    "    return total;\n",
+    "}\n",
+};
+
+static char *generate(size_t size, size_t *out_len){
+    char *src = malloc(size + 128);
+    if(!src) return NULL;
+
+    size_t len = 0;
+    for(size_t i = 0; len < size; i++){
+        const char *line = lines[i % (sizeof(lines) / sizeof(lines[0]))];
+        size_t line_len = strlen(line);
+        memcpy(&src[len], line, line_len);
+        len += line_len;
+    }
+    src[len] = '\0';
+    *out_len = len;
+    return src;
+}
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keeps the tokens of the last round in tokens so the caller can compare
+// them.
+static double measure(lexer *lexer, int threads, int rounds, tokenBuffer *tokens){
+    double best = 0;
+    for(int r = 0; r < rounds; r++){
+        tokenBuffer buffer;
+        lexer->position = 0;
+
+        double start = now();
+        bool ok = threads == 0 ? lexAll(lexer, &buffer) : lexAllParallel(lexer, &buffer, threads);
+        double elapsed = now() - start;
+        if(!ok) return 0;
+
+        if(r == rounds - 1) *tokens = buffer;
+        else freeTokenBuffer(&buffer);
+        if(best == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static bool sameValue(dataValue a, dataValue b){
+    if(a.type != b.type) return false;
+    switch(a.type){
+        case type_string: return strcmp(a.value.str_value, b.value.str_value) == 0;
+        case type_float: return a.value.f_value == b.value.f_value;
+        case type_double: return a.value.d_value == b.value.d_value;
+        case type_long_double: return a.value.ld_value == b.value.ld_value;
+        default: return a.value.ull_value == b.value.ull_value;
+    }
+}
+
+static bool sameTokens(tokenBuffer *a, tokenBuffer *b){
+    if(a->count != b->count || a->literal_count != b->literal_count) return false;
+    if(memcmp(a->kind, b->kind, a->count * sizeof(uint8_t)) != 0
+        || memcmp(a->offset, b->offset, a->count * sizeof(uint32_t)) != 0
+        || memcmp(a->length, b->length, a->count * sizeof(uint32_t)) != 0) return false;
+
+    for(int i = 0; i < a->literal_count; i++){
+        if(a->literals[i].index != b->literals[i].index) return false;
+        if(!sameValue(a->literals[i].value, b->literals[i].value)) return false;
+    }
+    return true;
+}
+
+// The serial baseline is a parseStatement loop into one arena, the same
+// allocation strategy each parallel range uses.
+static double measureParse(lexer *lexer, int threads, int rounds, flatAst *flat){
+    double best = 0;
+    for(int r = 0; r < rounds; r++){
+        lexer->position = 0;
+        astArena arena;
+        initArena(&arena);
+        parsedProgram program = {0};
+        astNode *body = NULL;
+        size_t capacity = 1024;
+        size_t count = 0;
+        astNode **statements = NULL;
+
+        double start = now();
+        if(threads == 0){
+            statements = malloc(capacity * sizeof(astNode *));
+            if(!statements) return 0;
+
+            astArena *previous = useArena(&arena);
+            parser parser;
+            initParser(&parser, lexer);
+            while(1){
+                astNode *node = parseStatement(&parser);
+                if(!node) break;
+                if(count == capacity){
+                    capacity *= 2;
+                    astNode **grown = realloc(statements, capacity * sizeof(astNode *));
+                    if(!grown) return 0;
+                    statements = grown;
+                }
+                statements[count++] = node;
+            }
+            body = createBodyNode(statements, count);
+            freeParser(&parser);
+            useArena(previous);
+        } else {
+            if(!parseProgramParallel(lexer, &program, threads)) return 0;
+            body = program.body;
+        }
+        double elapsed = now() - start;
+
+        // Flatten the last round so the caller can compare trees.
+        if(r == rounds - 1 && body) flattenAst(flat, body);
+        free(statements);
+        freeArena(&arena);
+        freeParsedProgram(&program);
+        if(best == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static bool sameFlat(flatAst *a, flatAst *b){
+    return a->node_count == b->node_count && a->extra_count == b->extra_count
+        && memcmp(a->nodes, b->nodes, a->node_count * sizeof(flatNode)) == 0
+        && (a->extra_count == 0 || memcmp(a->extra, b->extra, a->extra_count * sizeof(uint32_t)) == 0);
+}
+
+int main(int argc, char **argv){
+    int max_threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    if(max_threads < 1) max_threads = 1;
+
+    lexer lexer;
+    char *src = NULL;
+    if(argc > 1 && strcmp(argv[1], "-") != 0){
+        if(!initLexerFromFile(&lexer, argv[1])) return 1;
+    } else {
+        size_t len;
+        src = generate(64 << 20, &len);
+        if(!src) return 1;
+        initLexerBorrowed(&lexer, src, len);
+    }
+
+    tokenBuffer serial_tokens;
+    double serial = measure(&lexer, 0, rounds, &serial_tokens);
+    if(serial == 0) return 1;
+
+    printf("%.1f MB input, %d tokens\n", lexer.length / 1e6, serial_tokens.count);
+    printf("serial:     %8.1f MB/s\n", lexer.length / serial / 1e6);
+
+    for(int threads = 2; threads <= max_threads; threads++){
+        tokenBuffer tokens;
+        double elapsed = measure(&lexer, threads, rounds, &tokens);
+        bool same = elapsed != 0 && sameTokens(&serial_tokens, &tokens);
+        if(elapsed != 0) freeTokenBuffer(&tokens);
+        if(!same){
+            printf("%2d threads: token stream differs from serial\n", threads);
+            return 1;
+        }
+        printf("%2d threads: %8.1f MB/s  %.2fx\n", threads, lexer.length / elapsed / 1e6, serial / elapsed);
+    }
+    freeTokenBuffer(&serial_tokens);
+
+    flatAst serial_tree;
+    initFlatAst(&serial_tree);
+    serial = measureParse(&lexer, 0, rounds, &serial_tree);
+    if(serial == 0) return 1;
+    printf("parse serial:     %8.1f MB/s\n", lexer.length / serial / 1e6);
+
+    for(int threads = 2; threads <= max_threads; threads++){
+        flatAst tree;
+        initFlatAst(&tree);
+        double elapsed = measureParse(&lexer, threads, rounds, &tree);
+        bool same = elapsed != 0 && sameFlat(&serial_tree, &tree);
+        freeFlatAst(&tree);
+        if(!same){
+            printf("parse %2d threads: tree differs from serial\n", threads);
+            return 1;
+        }
+        printf("parse %2d threads: %8.1f MB/s  %.2fx\n", threads, lexer.length / elapsed / 1e6, serial / elapsed);
+    }
+    freeFlatAst(&serial_tree);
+
+    freeLexer(&lexer);
+    freeAtoms();
+    free(src);
+    return 0;
+}
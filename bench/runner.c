@@ -0,0 +1,255 @@
+// Lexer and parser throughput runner.
+// runner [-r rounds] file...
+// Every file is measured five times: lexing alone, lex+parse with malloc'd
+// nodes, lex+parse into an arena that is reset after each round, the same
+// with function bodies left lazy, as a signature-only consumer would, and
+// parseProgramStreaming, which resets its arena after every statement. Each
+// phase runs in its own child process so allocation counts and peak RSS do
+// not mix.
+#include "parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Counting allocations by interposing the allocator; glibc exports the
+// underlying implementations under these names.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void __libc_free(void *pointer);
+
+static size_t allocations;
+
+void *malloc(size_t size){
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size){
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size){
+    allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer){
+    __libc_free(pointer);
+}
+
+typedef struct {
+    size_t nodes;
+    size_t allocations;
+    double seconds;
+    bool complete;
+} result;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool countNode(astNode *node, int depth, void *ctx){
+    (void)node;
+    (void)depth;
+    (*(size_t *)ctx)++;
+    return true;
+}
+
+static result lexOnce(const char *src, long long length){
+    result r = {0};
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+
+    size_t before = allocations;
+    double start = now();
+    while(nextToken(&lexer).type != eof_token);
+    r.seconds = now() - start;
+    r.allocations = allocations - before;
+    r.complete = true;
+
+    freeLexer(&lexer);
+    freeAtoms();
+    return r;
+}
+
+typedef enum {
+    phase_lex,
+    phase_parse,
+    phase_arena,
+    phase_lazy,
+    phase_stream
+} phase;
+
+static const char *phaseNames[] = {"lex", "parse", "arena", "lazy", "stream"};
+
+static result parseOnce(const char *src, long long length, astArena *arena, bool lazy){
+    result r = {0};
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+
+    size_t before = allocations;
+    double start = now();
+    double counting = 0;
+    astArena *previous = useArena(arena);
+    parser parser;
+    initParser(&parser, &lexer);
+    parser.lazy_bodies = lazy;
+    while(1){
+        astNode *node = parseStatement(&parser);
+        if(!node) break;
+
+        double counted = now();
+        walkAst(node, countNode, NULL, &r.nodes);
+        counting += now() - counted;
+        freeAst(node);
+    }
+    useArena(previous);
+    if(arena) resetArena(arena);
+    r.seconds = now() - start - counting;
+    r.allocations = allocations - before;
+    r.complete = parser.current.type == eof_token;
+
+    freeParser(&parser);
+    freeLexer(&lexer);
+    freeAtoms();
+    return r;
+}
+
+typedef struct {
+    size_t nodes;
+    double counting;
+} streamCount;
+
+static bool countStatement(astNode *statement, void *ctx){
+    streamCount *count = ctx;
+    double counted = now();
+    walkAst(statement, countNode, NULL, &count->nodes);
+    count->counting += now() - counted;
+    return true;
+}
+
+static result streamOnce(const char *src, long long length){
+    result r = {0};
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+
+    size_t before = allocations;
+    double start = now();
+    streamCount count = {0};
+    parser parser;
+    initParser(&parser, &lexer);
+    r.complete = parseProgramStreaming(&parser, countStatement, &count);
+    r.seconds = now() - start - count.counting;
+    r.allocations = allocations - before;
+    r.nodes = count.nodes;
+
+    freeParser(&parser);
+    freeLexer(&lexer);
+    freeAtoms();
+    return r;
+}
+
+static size_t countTokens(const char *src, long long length){
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+
+    size_t tokens = 0;
+    while(nextToken(&lexer).type != eof_token) tokens++;
+    freeLexer(&lexer);
+    freeAtoms();
+    return tokens;
+}
+
+static void measure(const char *name, const char *src, long long length, size_t tokens, phase kind, int rounds){
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid < 0) return;
+    if(pid > 0){
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    astArena arena;
+    initArena(&arena);
+
+    result best = {0};
+    for(int i = 0; i < rounds; i++){
+        result r;
+        if(kind == phase_lex) r = lexOnce(src, length);
+        else if(kind == phase_stream) r = streamOnce(src, length);
+        else r = parseOnce(src, length, kind == phase_parse ? NULL : &arena, kind == phase_lazy);
+        if(i == 0 || r.seconds < best.seconds) best = r;
+    }
+    freeArena(&arena);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double mb = length / 1e6;
+    printf("%-28s %-6s %8.1f MB/s %8.2f Mtok/s", name, phaseNames[kind], mb / best.seconds, tokens / best.seconds / 1e6);
+    if(kind != phase_lex) printf(" %8.2f Mnode/s", best.nodes / best.seconds / 1e6);
+    else printf(" %15s", "");
+    printf(" %10zu allocs %8ld KB peak", best.allocations, usage.ru_maxrss);
+    if(!best.complete) printf("  (stopped early)");
+    printf("\n");
+    fflush(stdout);
+    _exit(0);
+}
+
+static char *readFile(const char *path, long long *length){
+    FILE *file = fopen(path, "rb");
+    if(!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+
+    char *src = malloc(*length + 1);
+    if(src && fread(src, 1, *length, file) != (size_t)*length){
+        free(src);
+        src = NULL;
+    }
+    fclose(file);
+    if(src) src[*length] = '\0';
+    return src;
+}
+
+int main(int argc, char **argv){
+    int rounds = 5;
+    int first = 1;
+    if(argc > 2 && strcmp(argv[1], "-r") == 0){
+        rounds = atoi(argv[2]);
+        first = 3;
+    }
+    if(first >= argc){
+        fprintf(stderr, "usage: runner [-r rounds] file...\n");
+        return 1;
+    }
+
+    for(int i = first; i < argc; i++){
+        long long length;
+        char *src = readFile(argv[i], &length);
+        if(!src){
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            continue;
+        }
+
+        const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+        size_t tokens = countTokens(src, length);
+        measure(name, src, length, tokens, phase_lex, rounds);
+        measure(name, src, length, tokens, phase_parse, rounds);
+        measure(name, src, length, tokens, phase_arena, rounds);
+        measure(name, src, length, tokens, phase_lazy, rounds);
+        measure(name, src, length, tokens, phase_stream, rounds);
+        free(src);
+    }
+    return 0;
+}
@@ -0,0 +1,361 @@
+#include "flatast.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool reserve(void **items, uint32_t *capacity, uint32_t needed, size_t size){
+    if(needed <= *capacity) return true;
+
+    uint32_t grown = *capacity ? *capacity : 256;
+    while(grown < needed) grown *= 2;
+
+    void *resized = realloc(*items, grown * size);
+    if(!resized) return false;
+
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+void initFlatAst(flatAst *ast){
+    memset(ast, 0, sizeof(flatAst));
+}
+
+static uint32_t pushNode(flatAst *ast, nodeType type, uint8_t op, uint16_t aux, uint32_t lhs, uint32_t rhs){
+    // Index 0 is the placeholder for a missing child.
+    uint32_t needed = ast->node_count ? ast->node_count + 1 : 2;
+    if(!reserve((void **)&ast->nodes, &ast->node_capacity, needed, sizeof(flatNode))) return 0;
+    if(ast->node_count == 0){
+        memset(&ast->nodes[0], 0, sizeof(flatNode));
+        ast->node_count = 1;
+    }
+
+    flatNode *node = &ast->nodes[ast->node_count];
+    node->type = (uint8_t)type;
+    node->op = op;
+    node->aux = aux;
+    node->lhs = lhs;
+    node->rhs = rhs;
+    return ast->node_count++;
+}
+
+static bool pushChild(flatAst *ast, uint32_t index){
+    if(!reserve((void **)&ast->stack, &ast->stack_capacity, ast->stack_count + 1, sizeof(uint32_t))) return false;
+    ast->stack[ast->stack_count++] = index;
+    return true;
+}
+
+// Moves the top count child indices of the stack to extra and returns where
+// they start.
+static uint32_t popChildren(flatAst *ast, uint32_t count, bool *ok){
+    if(!*ok) return 0;
+    if(!reserve((void **)&ast->extra, &ast->extra_capacity, ast->extra_count + count, sizeof(uint32_t))){
+        *ok = false;
+        return 0;
+    }
+
+    uint32_t start = ast->extra_count;
+    ast->stack_count -= count;
+    if(count > 0) memcpy(&ast->extra[start], &ast->stack[ast->stack_count], count * sizeof(uint32_t));
+    ast->extra_count += count;
+    return start;
+}
+
+bool isInlineValue(dataType type){
+    switch(type){
+        case type_void:
+        case type_bool:
+        case type_short:
+        case type_ushort:
+        case type_int:
+        case type_uint:
+        case type_float:
+        case type_null:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t flattenValue(flatAst *ast, dataValue *value, bool *ok){
+    uint32_t bits = 0;
+    if(isInlineValue(value->type)){
+        switch(value->type){
+            case type_bool: bits = (uint32_t)value->value.b_value; break;
+            case type_short: bits = (uint32_t)value->value.s_value; break;
+            case type_ushort: bits = value->value.us_value; break;
+            case type_int: bits = (uint32_t)value->value.i_value; break;
+            case type_uint: bits = value->value.ui_value; break;
+            case type_float: memcpy(&bits, &value->value.f_value, sizeof(bits)); break;
+            default: break;
+        }
+    } else {
+        if(!reserve((void **)&ast->values, &ast->value_capacity, ast->value_count + 1, sizeof(dataValue))){
+            *ok = false;
+            return 0;
+        }
+        bits = ast->value_count;
+        ast->values[ast->value_count++] = *value;
+    }
+    uint32_t index = pushNode(ast, value_node, (uint8_t)value->type, 0, bits, 0);
+    if(!index) *ok = false;
+    return index;
+}
+
+// Trees are flattened bottom-up by walkAst, so depth is not limited by the C
+// stack. Each node leaves its index on the stack when the walk leaves it;
+// its parent then finds the indices of its non-NULL children on top, in
+// order.
+typedef struct {
+    flatAst *ast;
+    bool ok;
+} flattenPass;
+
+static void pushIndex(flatAst *ast, uint32_t index, bool *ok){
+    if(*ok && !pushChild(ast, index)) *ok = false;
+}
+
+static void pushName(flatAst *ast, const char *name, bool *ok){
+    pushIndex(ast, nameAtom(name), ok);
+}
+
+// Pops the index the walk left for child, or gives 0 if there is none.
+// Children come off in reverse order.
+static uint32_t popChild(flatAst *ast, astNode *child){
+    return child ? ast->stack[--ast->stack_count] : 0;
+}
+
+// Puts a 0 on the stack in place of every NULL slot, so the top count
+// entries line up with slots.
+static void alignChildren(flatAst *ast, astNode **slots, int count, bool *ok){
+    int present = 0;
+    for(int i = 0; i < count; i++){
+        if(slots[i]) present++;
+    }
+    if(present == count || !*ok) return;
+
+    if(!reserve((void **)&ast->stack, &ast->stack_capacity, ast->stack_count + count - present, sizeof(uint32_t))){
+        *ok = false;
+        return;
+    }
+    uint32_t from = ast->stack_count;
+    uint32_t to = ast->stack_count + count - present;
+    ast->stack_count = to;
+    for(int i = count - 1; i >= 0; i--){
+        ast->stack[--to] = slots[i] ? ast->stack[--from] : 0;
+    }
+}
+
+static bool enterFlatten(astNode *node, int depth, void *ctx){
+    (void)depth;
+    flatAst *ast = ((flattenPass *)ctx)->ast;
+    bool *ok = &((flattenPass *)ctx)->ok;
+
+    // An impl's names go to extra ahead of its body's, as they always have;
+    // where they start waits on the stack below the body.
+    if(node->type == impl_node){
+        pushName(ast, node->impl_stmt.trait_name, ok);
+        pushName(ast, node->impl_stmt.target, ok);
+        pushIndex(ast, popChildren(ast, 2, ok), ok);
+    }
+    return *ok;
+}
+
+static void leaveFlatten(astNode *node, int depth, void *ctx){
+    (void)depth;
+    flatAst *ast = ((flattenPass *)ctx)->ast;
+    bool *ok = &((flattenPass *)ctx)->ok;
+    if(!*ok) return;
+
+    uint32_t lhs = 0;
+    uint32_t rhs = 0;
+    uint8_t op = 0;
+    uint16_t aux = 0;
+
+    switch(node->type){
+        case identifier_node:
+            lhs = nameAtom(node->identifier.name);
+            break;
+        case value_node:
+            pushIndex(ast, flattenValue(ast, &node->data.value, ok), ok);
+            return;
+        case assignment_node:
+            rhs = popChild(ast, node->assignment.right);
+            lhs = popChild(ast, node->assignment.left);
+            op = (uint8_t)node->assignment.op;
+            break;
+        case define_node: {
+            uint32_t initializer = popChild(ast, node->define.initializer);
+            lhs = popChild(ast, node->define.type);
+            pushName(ast, node->define.identifier, ok);
+            pushIndex(ast, initializer, ok);
+            rhs = popChildren(ast, 2, ok);
+            aux = (uint16_t)node->define.flags;
+            break;
+        }
+        case pointer_node:
+            lhs = popChild(ast, node->pointer.ptr);
+            break;
+        case body_node:
+            alignChildren(ast, node->body.elements, node->body.elements_count, ok);
+            lhs = popChildren(ast, node->body.elements_count, ok);
+            rhs = node->body.elements_count;
+            break;
+        case array_node:
+            alignChildren(ast, (astNode *[]){node->array.type, node->array.size, node->array.elements}, 3, ok);
+            lhs = popChildren(ast, 3, ok);
+            break;
+        case array_access_node:
+            rhs = popChild(ast, node->array_access.index);
+            lhs = popChild(ast, node->array_access.array);
+            break;
+        case function_node: {
+            uint32_t body = popChild(ast, node->function.body);
+            uint32_t params = popChild(ast, node->function.params);
+            uint32_t return_type = popChild(ast, node->function.return_type);
+            pushName(ast, node->function.identifier, ok);
+            pushIndex(ast, return_type, ok);
+            pushIndex(ast, params, ok);
+            pushIndex(ast, body, ok);
+            lhs = popChildren(ast, 4, ok);
+            aux = (uint16_t)node->function.flags;
+            op = (uint8_t)node->function.is_variadic;
+            break;
+        }
+        case call_node:
+            rhs = popChild(ast, node->call.args);
+            lhs = popChild(ast, node->call.identifier);
+            break;
+        case data_operation_node:
+            rhs = popChild(ast, node->operation.right);
+            lhs = popChild(ast, node->operation.left);
+            op = (uint8_t)node->operation.op;
+            break;
+        case if_node:
+            alignChildren(ast, (astNode *[]){node->if_stmt.then_branch, node->if_stmt.else_branch}, 2, ok);
+            rhs = popChildren(ast, 2, ok);
+            if(*ok) lhs = popChild(ast, node->if_stmt.condition);
+            break;
+        case switch_node:
+            rhs = popChild(ast, node->switch_stmt.body);
+            lhs = popChild(ast, node->switch_stmt.condition);
+            break;
+        case case_node:
+            lhs = popChild(ast, node->case_stmt.value);
+            break;
+        case for_node:
+            alignChildren(ast, (astNode *[]){node->for_stmt.initializer, node->for_stmt.condition, node->for_stmt.increment, node->for_stmt.then_branch}, 4, ok);
+            lhs = popChildren(ast, 4, ok);
+            break;
+        case while_node:
+            rhs = popChild(ast, node->while_stmt.then_branch);
+            lhs = popChild(ast, node->while_stmt.condition);
+            break;
+        case do_while_node:
+            rhs = popChild(ast, node->do_while_stmt.condition);
+            lhs = popChild(ast, node->do_while_stmt.body);
+            break;
+        case return_node:
+            lhs = popChild(ast, node->return_stmt.value);
+            break;
+        case import_node:
+            lhs = popChild(ast, node->import_stmt.identifier);
+            break;
+        case struct_node:
+            lhs = nameAtom(node->struct_stmt.identifier);
+            rhs = popChild(ast, node->struct_stmt.body);
+            break;
+        case impl_node:
+            rhs = popChild(ast, node->impl_stmt.body);
+            lhs = ast->stack[--ast->stack_count];
+            break;
+        case trait_node:
+            lhs = nameAtom(node->trait_stmt.identifier);
+            rhs = popChild(ast, node->trait_stmt.body);
+            break;
+        case dot_access_node:
+            lhs = popChild(ast, node->dot_access.object);
+            rhs = nameAtom(node->dot_access.member);
+            break;
+        case arrow_access_node:
+            lhs = popChild(ast, node->arrow_access.object);
+            rhs = nameAtom(node->arrow_access.member);
+            break;
+        case enum_node:
+            lhs = nameAtom(node->enum_stmt.identifier);
+            rhs = popChild(ast, node->enum_stmt.body);
+            break;
+        case union_node:
+            lhs = nameAtom(node->union_stmt.identifier);
+            rhs = popChild(ast, node->union_stmt.body);
+            break;
+        case sizeof_node:
+            lhs = popChild(ast, node->sizeof_expr.operand);
+            break;
+        case typeof_node:
+            lhs = popChild(ast, node->typeof_expr.operand);
+            break;
+        case cast_node:
+            rhs = popChild(ast, node->cast_expr.operand);
+            lhs = popChild(ast, node->cast_expr.type);
+            break;
+        case typedef_node:
+            lhs = popChild(ast, node->typedef_stmt.type);
+            rhs = nameAtom(node->typedef_stmt.alias_name);
+            break;
+        case lazy_body_node:
+            lhs = (uint32_t)node->lazy_body.start;
+            rhs = (uint32_t)node->lazy_body.end;
+            break;
+        default:
+            break;
+    }
+    if(!*ok) return;
+
+    uint32_t index = pushNode(ast, node->type, op, aux, lhs, rhs);
+    if(!index) *ok = false;
+    pushIndex(ast, index, ok);
+}
+
+uint32_t flattenAst(flatAst *ast, astNode *node){
+    if(!node) return 0;
+
+    flattenPass pass = {ast, true};
+    uint32_t stack_count = ast->stack_count;
+    if(!walkAst(node, enterFlatten, leaveFlatten, &pass)) pass.ok = false;
+    uint32_t root = pass.ok ? ast->stack[ast->stack_count - 1] : 0;
+    ast->stack_count = stack_count;
+    return root;
+}
+
+dataValue inlineFlatValue(const flatNode *node){
+    dataValue value = {0};
+    value.type = (dataType)node->op;
+    switch(value.type){
+        case type_bool: value.value.b_value = (int)node->lhs; break;
+        case type_short: value.value.s_value = (short)node->lhs; break;
+        case type_ushort: value.value.us_value = (unsigned short)node->lhs; break;
+        case type_int: value.value.i_value = (int)node->lhs; break;
+        case type_uint: value.value.ui_value = node->lhs; break;
+        case type_float: memcpy(&value.value.f_value, &node->lhs, sizeof(node->lhs)); break;
+        default: break;
+    }
+    return value;
+}
+
+dataValue flatValue(flatAst *ast, uint32_t index){
+    flatNode *node = &ast->nodes[index];
+    if(!isInlineValue((dataType)node->op)) return ast->values[node->lhs];
+    return inlineFlatValue(node);
+}
+
+size_t flatAstBytes(flatAst *ast){
+    return ast->node_count * sizeof(flatNode) + ast->extra_count * sizeof(uint32_t) + ast->value_count * sizeof(dataValue);
+}
+
+void freeFlatAst(flatAst *ast){
+    free(ast->nodes);
+    free(ast->extra);
+    free(ast->values);
+    free(ast->stack);
+    initFlatAst(ast);
+}
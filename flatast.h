@@ -0,0 +1,78 @@
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include "ast.h"
+#include "atom.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// A flattened copy of a pointer AST. Nodes sit in one array and name their
+// children by index; index 0 is a placeholder that stands for a missing
+// child. Children always come before their parent, so a plain scan of nodes
+// visits every tree bottom-up.
+//
+// What lhs, rhs, op and aux hold depends on the node type:
+//   identifier                      lhs = name atom
+//   value                           op = dataType; lhs = the value itself for
+//                                   types up to 32 bits, else a values index
+//   assignment, data_operation      op = opType; lhs, rhs = operands
+//   define                          aux = flags; lhs = type;
+//                                   rhs -> extra [name atom, initializer]
+//   body                            lhs -> extra with rhs element indices
+//   array                           lhs -> extra [type, size, elements]
+//   function                        aux = flags; op = is_variadic;
+//                                   lhs -> extra [name atom, return type,
+//                                   params, body]
+//   if                              lhs = condition;
+//                                   rhs -> extra [then, else]
+//   for                             lhs -> extra [initializer, condition,
+//                                   increment, then]
+//   impl                            lhs -> extra [trait atom, target atom];
+//                                   rhs = body
+//   struct, trait, enum, union      lhs = name atom; rhs = body
+//   dot_access, arrow_access        lhs = object; rhs = member atom
+//   typedef                         lhs = type; rhs = alias atom
+//   lazy_body                       lhs, rhs = start and end offsets, low
+//                                   32 bits
+//   any other node                  lhs, rhs = its children in declaration
+//                                   order
+typedef struct {
+    uint8_t type;
+    uint8_t op;
+    uint16_t aux;
+    uint32_t lhs;
+    uint32_t rhs;
+} flatNode;
+
+typedef struct {
+    flatNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+
+    uint32_t *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    dataValue *values;
+    uint32_t value_count;
+    uint32_t value_capacity;
+
+    // Scratch space for child indices while a node is being flattened.
+    uint32_t *stack;
+    uint32_t stack_count;
+    uint32_t stack_capacity;
+} flatAst;
+
+void initFlatAst(flatAst *ast);
+// Appends a copy of the tree under node and returns the index of its root,
+// or 0 if node is NULL or memory ran out.
+uint32_t flattenAst(flatAst *ast, astNode *node);
+dataValue flatValue(flatAst *ast, uint32_t index);
+// Values of up to 32 bits sit in the value node's lhs; isInlineValue says
+// which types those are and inlineFlatValue reads one back.
+bool isInlineValue(dataType type);
+dataValue inlineFlatValue(const flatNode *node);
+size_t flatAstBytes(flatAst *ast);
+void freeFlatAst(flatAst *ast);
+
+#endif
@@ -1,9 +1,60 @@
 #include "lexer.h"
 #include <string.h>
-#include <ctype.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <float.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+enum {
+    char_ident_start = 1 << 0,
+    char_ident = 1 << 1,
+    char_digit = 1 << 2,
+    char_hex = 1 << 3,
+    char_space = 1 << 4,
+    char_operator = 1 << 5
+};
+
+#define S char_space
+#define D (char_digit | char_hex | char_ident)
+#define H (char_hex | char_ident_start | char_ident)
+#define L (char_ident_start | char_ident)
+#define O char_operator
+
+// One load classifies a byte. Unlike <ctype.h> this ignores the locale and
+// is defined for every char value, including negative ones.
+static const unsigned char charClass[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, O, 0, 0, 0, O, O, 0, O, O, O, O, O, O, O, O,
+    D, D, D, D, D, D, D, D, D, D, O, O, O, O, O, 0,
+    0, H, H, H, H, H, H, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, O, 0, O, O, L,
+    0, H, H, H, H, H, H, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#undef S
+#undef D
+#undef H
+#undef L
+#undef O
+
+#define charIs(c, cls) (charClass[(unsigned char)(c)] & (cls))
 
 char peek(lexer *lexer){
     return lexer->src[lexer->position];
@@ -19,12 +70,6 @@ char advance(lexer *lexer){
     if(current == '\0') return '\0';
 
     lexer->position++;
-    if(current == '\n'){
-        lexer->line++;
-        lexer->column = 1;
-    } else{
-        lexer->column++;
-    }
     return current;
 }
 
@@ -40,22 +85,310 @@ bool match(lexer *lexer, char expected){
     return true;
 }
 
+// Whitespace and comment bodies are skipped in blocks: a scanner returns
+// the first position at or after position that it is not allowed to skip.
+// Newline scanners count '\n' bytes in [position, length) and, when starts is
+// not NULL, store the offset following each one. String scanners stop at the
+// delimiter, a backslash or a NUL byte.
+typedef long long (*scanFn)(const char *src, long long position, long long length);
+typedef long (*newlineFn)(const char *src, long long position, long long length, long long *starts);
+typedef long long (*stringFn)(const char *src, long long position, long long length, char delimiter);
+
+static long long scanSpacesScalar(const char *src, long long position, long long length){
+    while(position < length && charIs(src[position], char_space)) position++;
+    return position;
+}
+
+static long long scanToStarScalar(const char *src, long long position, long long length){
+    while(position < length && src[position] != '*') position++;
+    return position;
+}
+
+static long long scanStringScalar(const char *src, long long position, long long length, char delimiter){
+    while(position < length && src[position] != delimiter && src[position] != '\\' && src[position] != '\0') position++;
+    return position;
+}
+
+static long scanNewlinesScalar(const char *src, long long position, long long length, long long *starts){
+    long count = 0;
+    for(; position < length; position++){
+        if(src[position] != '\n') continue;
+        if(starts) starts[count] = position + 1;
+        count++;
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static inline long recordNewlines(unsigned int mask, long long base, long long *starts){
+    long count = __builtin_popcount(mask);
+    if(starts){
+        while(mask){
+            *starts++ = base + __builtin_ctz(mask) + 1;
+            mask &= mask - 1;
+        }
+    }
+    return count;
+}
+
+static long long scanSpacesSSE2(const char *src, long long position, long long length){
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i control_span = _mm_set1_epi8('\r' - '\t');
+
+    while(position + 16 <= length){
+        __m128i block = _mm_loadu_si128((const __m128i *)&src[position]);
+        __m128i control = _mm_sub_epi8(block, tab);
+        control = _mm_cmpeq_epi8(_mm_min_epu8(control, control_span), control);
+        unsigned int spaces = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, space), control));
+
+        if(spaces != 0xFFFF) return position + __builtin_ctz(~spaces);
+        position += 16;
+    }
+    return scanSpacesScalar(src, position, length);
+}
+
+static long long scanToStarSSE2(const char *src, long long position, long long length){
+    const __m128i star = _mm_set1_epi8('*');
+
+    while(position + 16 <= length){
+        __m128i block = _mm_loadu_si128((const __m128i *)&src[position]);
+        unsigned int stars = _mm_movemask_epi8(_mm_cmpeq_epi8(block, star));
+
+        if(stars) return position + __builtin_ctz(stars);
+        position += 16;
+    }
+    return scanToStarScalar(src, position, length);
+}
+
+static long long scanStringSSE2(const char *src, long long position, long long length, char delimiter){
+    const __m128i quote = _mm_set1_epi8(delimiter);
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+
+    while(position + 16 <= length){
+        __m128i block = _mm_loadu_si128((const __m128i *)&src[position]);
+        __m128i stops = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(stops, _mm_cmpeq_epi8(block, zero)));
+
+        if(mask) return position + __builtin_ctz(mask);
+        position += 16;
+    }
+    return scanStringScalar(src, position, length, delimiter);
+}
+
+static long scanNewlinesSSE2(const char *src, long long position, long long length, long long *starts){
+    const __m128i newline = _mm_set1_epi8('\n');
+    long count = 0;
+
+    while(position + 16 <= length){
+        __m128i block = _mm_loadu_si128((const __m128i *)&src[position]);
+        unsigned int newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+
+        count += recordNewlines(newlines, position, starts ? &starts[count] : NULL);
+        position += 16;
+    }
+    return count + scanNewlinesScalar(src, position, length, starts ? &starts[count] : NULL);
+}
+
+__attribute__((target("avx2")))
+static long long scanSpacesAVX2(const char *src, long long position, long long length){
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i control_span = _mm256_set1_epi8('\r' - '\t');
+
+    while(position + 32 <= length){
+        __m256i block = _mm256_loadu_si256((const __m256i *)&src[position]);
+        __m256i control = _mm256_sub_epi8(block, tab);
+        control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, control_span), control);
+        unsigned int spaces = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, space), control));
+
+        if(spaces != 0xFFFFFFFFu) return position + __builtin_ctz(~spaces);
+        position += 32;
+    }
+    return scanSpacesSSE2(src, position, length);
+}
+
+__attribute__((target("avx2")))
+static long long scanToStarAVX2(const char *src, long long position, long long length){
+    const __m256i star = _mm256_set1_epi8('*');
+
+    while(position + 32 <= length){
+        __m256i block = _mm256_loadu_si256((const __m256i *)&src[position]);
+        unsigned int stars = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, star));
+
+        if(stars) return position + __builtin_ctz(stars);
+        position += 32;
+    }
+    return scanToStarSSE2(src, position, length);
+}
+
+__attribute__((target("avx2")))
+static long long scanStringAVX2(const char *src, long long position, long long length, char delimiter){
+    const __m256i quote = _mm256_set1_epi8(delimiter);
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i zero = _mm256_setzero_si256();
+
+    while(position + 32 <= length){
+        __m256i block = _mm256_loadu_si256((const __m256i *)&src[position]);
+        __m256i stops = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(stops, _mm256_cmpeq_epi8(block, zero)));
+
+        if(mask) return position + __builtin_ctz(mask);
+        position += 32;
+    }
+    return scanStringSSE2(src, position, length, delimiter);
+}
+
+__attribute__((target("avx2,popcnt")))
+static long scanNewlinesAVX2(const char *src, long long position, long long length, long long *starts){
+    const __m256i newline = _mm256_set1_epi8('\n');
+    long count = 0;
+
+    while(position + 32 <= length){
+        __m256i block = _mm256_loadu_si256((const __m256i *)&src[position]);
+        unsigned int newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+
+        count += recordNewlines(newlines, position, starts ? &starts[count] : NULL);
+        position += 32;
+    }
+    return count + scanNewlinesSSE2(src, position, length, starts ? &starts[count] : NULL);
+}
+#endif
+
+static long long scanSpacesResolve(const char *src, long long position, long long length);
+static long long scanToStarResolve(const char *src, long long position, long long length);
+static long scanNewlinesResolve(const char *src, long long position, long long length, long long *starts);
+static long long scanStringResolve(const char *src, long long position, long long length, char delimiter);
+
+static scanFn scanSpaces = scanSpacesResolve;
+static scanFn scanToStar = scanToStarResolve;
+static newlineFn scanNewlines = scanNewlinesResolve;
+static stringFn scanString = scanStringResolve;
+
+static void resolveScanners(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        scanSpaces = scanSpacesAVX2;
+        scanToStar = scanToStarAVX2;
+        scanNewlines = scanNewlinesAVX2;
+        scanString = scanStringAVX2;
+    } else {
+        scanSpaces = scanSpacesSSE2;
+        scanToStar = scanToStarSSE2;
+        scanNewlines = scanNewlinesSSE2;
+        scanString = scanStringSSE2;
+    }
+#else
+    scanSpaces = scanSpacesScalar;
+    scanToStar = scanToStarScalar;
+    scanNewlines = scanNewlinesScalar;
+    scanString = scanStringScalar;
+#endif
+}
+
+static long long scanSpacesResolve(const char *src, long long position, long long length){
+    resolveScanners();
+    return scanSpaces(src, position, length);
+}
+
+static long long scanToStarResolve(const char *src, long long position, long long length){
+    resolveScanners();
+    return scanToStar(src, position, length);
+}
+
+static long scanNewlinesResolve(const char *src, long long position, long long length, long long *starts){
+    resolveScanners();
+    return scanNewlines(src, position, length, starts);
+}
+
+static long long scanStringResolve(const char *src, long long position, long long length, char delimiter){
+    resolveScanners();
+    return scanString(src, position, length, delimiter);
+}
+
+// Streaming lexers keep only a window of the input. Refilling discards
+// everything before the current position, moves the rest to the front and
+// reads until the window is full or the input ends.
+static bool refillWindow(lexer *lexer){
+    if(lexer->stream_eof) return false;
+
+    char *window = (char *)lexer->src;
+    long discarded = scanNewlines(window, 0, lexer->position, NULL);
+    if(discarded){
+        long long last = lexer->position - 1;
+        while(window[last] != '\n') last--;
+        lexer->base_line += discarded;
+        lexer->base_line_start = lexer->base + last + 1;
+    }
+
+    long long keep = lexer->length - lexer->position;
+    memmove(window, &window[lexer->position], keep);
+    lexer->base += lexer->position;
+    lexer->position = 0;
+    lexer->length = keep;
+
+    long long before = lexer->length;
+    while(lexer->length < lexer->capacity){
+        ssize_t n = read(lexer->fd, &window[lexer->length], lexer->capacity - lexer->length);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            lexer->stream_eof = true;
+            break;
+        }
+        lexer->length += n;
+    }
+    window[lexer->length] = '\0';
+    return lexer->length > before;
+}
+
+static inline bool reserveWindow(lexer *lexer, long long needed){
+    if(lexer->source != source_stream || lexer->length - lexer->position >= needed) return false;
+    return refillWindow(lexer);
+}
+
+// False while the token just lexed ends at the end of a stream's window with
+// more input to come: it may continue past the window, so nextToken lexes it
+// again.
+static inline bool tokenComplete(lexer *lexer){
+    return lexer->position < lexer->length || lexer->stream_eof;
+}
+
 void skipWhiteSpace(lexer *lexer){
     while(1){
-        if(isspace(peek(lexer))){
-            advance(lexer);
+        reserveWindow(lexer, 2);
+
+        if(charIs(peek(lexer), char_space)){
+            if(!charIs(peekNext(lexer), char_space)){
+                advance(lexer);
+                continue;
+            }
+            lexer->position = scanSpaces(lexer->src, lexer->position, lexer->length);
         } 
         else if(peek(lexer) == '/' && peekNext(lexer) == '/'){
-            while(!isAtEnd(lexer) && peek(lexer) != '\n'){
-                advance(lexer);
+            while(1){
+                const char *newline = memchr(&lexer->src[lexer->position], '\n', lexer->length - lexer->position);
+                lexer->position = newline ? newline - lexer->src : lexer->length;
+
+                if(newline || !reserveWindow(lexer, 1)) break;
             }
         }
         else if(peek(lexer) == '/' && peekNext(lexer) == '*'){
             advance(lexer);
             advance(lexer);
 
-            while(!isAtEnd(lexer)){
-                if(peek(lexer) == '*' && peekNext(lexer) == '/'){
+            while(1){
+                lexer->position = scanToStar(lexer->src, lexer->position, lexer->length);
+
+                if(isAtEnd(lexer)){
+                    if(reserveWindow(lexer, 2)) continue;
+                    break;
+                }
+                reserveWindow(lexer, 2);
+                if(peekNext(lexer) == '/'){
                     advance(lexer);
                     advance(lexer);
                     break;
@@ -76,20 +409,112 @@ static int hexValue(char c) {
     return -1;
 }
 
-token createToken(lexer *lexer, token_type type, token_data *data, char *lexeme){
+token createToken(lexer *lexer, token_type type, token_data *data, long long start){
     token token;
     token.type = type;
     token.data = *data;
-    token.line = lexer->line;
-    token.column = lexer->column;
-    token.lexeme = strdup(lexeme);
+    token.start = lexer->base + start;
+    token.length = (int)(lexer->position - start);
+    return token;
+}
+
+const char *tokenLexeme(lexer *lexer, token *token){
+    return &lexer->src[token->start - lexer->base];
+}
 
-    if(!token.lexeme){
-        token.type = eof_token;
-        token.data.identifier = NULL;
-        return token;
+char *copyLexeme(lexer *lexer, token *token){
+    char *text = malloc(token->length + 1);
+    if(!text) return NULL;
+
+    memcpy(text, tokenLexeme(lexer, token), token->length);
+    text[token->length] = '\0';
+    return text;
+}
+
+static bool parseInteger(const char *digits, long long len, int base, unsigned long long *out){
+    unsigned long long value = 0;
+    unsigned long long limit = ULLONG_MAX / base;
+
+    for(long long i = 0; i < len; i++){
+        unsigned int digit = (unsigned int)hexValue(digits[i]);
+        if(value > limit || value * base > ULLONG_MAX - digit) return false;
+        value = value * base + digit;
     }
-    return token;
+    *out = value;
+    return true;
+}
+
+#define FLOAT_DIGITS 800
+
+static const double exactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Float literals are digits '.' digits. When the significant digits fit in
+// 53 bits and the power of ten is exact, a single division rounds correctly.
+// Everything else goes to strtod/strtold as a normalized copy on the stack:
+// at most FLOAT_DIGITS significant digits, a trailing 1 standing in for any
+// nonzero digits past them, and an explicit exponent.
+static void parseFloat(const char *src, long long len, dataValue *out){
+    char buffer[FLOAT_DIGITS + 32];
+    unsigned long long mantissa = 0;
+    long long exponent = 0;
+    int digits = 0;
+    int significant = 0;
+    int kept = 0;
+    bool fraction = false;
+    bool sticky = false;
+
+    for(long long i = 0; i < len; i++){
+        char c = src[i];
+        if(c == '.'){
+            fraction = true;
+            continue;
+        }
+        if(c == '0' && digits == 0){
+            if(fraction) exponent--;
+            continue;
+        }
+
+        digits++;
+        if(c != '0') significant = digits;
+        if(digits <= 19) mantissa = mantissa * 10 + (c - '0');
+        if(kept < FLOAT_DIGITS){
+            buffer[kept++] = c;
+            if(fraction) exponent--;
+        } else {
+            if(c != '0') sticky = true;
+            if(!fraction) exponent++;
+        }
+    }
+
+    // More digits than a double holds: keep them as a long double. Trailing
+    // zeros do not count, so 0.1000 stays a double like 0.1.
+    if(significant > 17){
+        if(sticky){
+            buffer[kept++] = '1';
+            exponent--;
+        }
+        snprintf(&buffer[kept], sizeof(buffer) - kept, "e%lld", exponent);
+        out->type = type_long_double;
+        out->value.ld_value = strtold(buffer, NULL);
+        return;
+    }
+
+    out->type = type_double;
+    if(digits == 0){
+        out->value.d_value = 0.0;
+        return;
+    }
+#if FLT_EVAL_METHOD == 0
+    if(mantissa <= (1ULL << 53) && exponent >= -22){
+        out->value.d_value = (double)mantissa / exactPowers[-exponent];
+        return;
+    }
+#endif
+    snprintf(&buffer[kept], sizeof(buffer) - kept, "e%lld", exponent);
+    out->value.d_value = strtod(buffer, NULL);
 }
 
 token lexNums(lexer *lexer){
@@ -106,7 +531,7 @@ token lexNums(lexer *lexer){
             prefix_offset = 2;
             advance(lexer);
             advance(lexer);
-            while(isxdigit(peek(lexer))) advance(lexer);
+            while(charIs(peek(lexer), char_hex)) advance(lexer);
             
         } else if (next == 'b' || next == 'B'){
             base = 2;
@@ -122,11 +547,11 @@ token lexNums(lexer *lexer){
             advance(lexer);
             while(peek(lexer) >= '0' && peek(lexer) <= '7') advance(lexer);
             
-        } else if(isdigit(next)){
+        } else if(charIs(next, char_digit)){
             base = 8;
             advance(lexer);
             
-            while(isdigit(peek(lexer))) {
+            while(charIs(peek(lexer), char_digit)) {
                 if(peek(lexer) == '8' || peek(lexer) == '9') base = 10;
                 advance(lexer);
             }
@@ -134,87 +559,65 @@ token lexNums(lexer *lexer){
             advance(lexer);
         }
     } else {
-        while(isdigit(peek(lexer))){
+        while(charIs(peek(lexer), char_digit)){
             advance(lexer);
         }
     }
 
-    if(base == 10 && peek(lexer) == '.' && isdigit(peekNext(lexer))){
+    if(base == 10 && peek(lexer) == '.' && charIs(peekNext(lexer), char_digit)){
         is_float = true;
         advance(lexer);
-        while(isdigit(peek(lexer))){
+        while(charIs(peek(lexer), char_digit)){
             advance(lexer);
         }
     }
 
-    long long len = lexer->position - start;
-    char *numStr = malloc(len + 1);
-    if(!numStr) return createToken(lexer, null_token, &(token_data){0}, ""); 
-    
-    memcpy(numStr, &lexer->src[start], len);
-    numStr[len] = '\0';
-
     token_data data = {0};
-    token token;
+    const char *span = &lexer->src[start];
+    long long len = lexer->position - start;
 
     if(is_float){
-        double val = strtod(numStr, NULL);
-        data.properties.value.type = type_double;
-        data.properties.value.value.d_value = val;
-        token = createToken(lexer, float_literal_token, &data, numStr);
-    } else {
-        char *parseStr = numStr + prefix_offset;
-        
-        long long val = strtoll(parseStr, NULL, base);
-        
-        if(val >= INT_MIN && val <= INT_MAX){
-            data.properties.value.type = type_int;
-            data.properties.value.value.i_value = (int)val;
-            token = createToken(lexer, int_literal_token, &data, numStr);
-        } else if(val >= LONG_MIN && val <= LONG_MAX){
-            data.properties.value.type = type_long;
-            data.properties.value.value.l_value = (long)val;
-            token = createToken(lexer, long_literal_token, &data, numStr);
-        } else {
-            data.properties.value.type = type_long_long;
-            data.properties.value.value.ll_value = val;
-            token = createToken(lexer, long_long_literal_token, &data, numStr);
-        }
+        parseFloat(span, len, &data.properties.value);
+        token_type type = data.properties.value.type == type_long_double ? long_double_literal_token : float_literal_token;
+        return createToken(lexer, type, &data, start);
     }
-    
-    free(numStr);
-    return token;
-}
-
-token lexStr(lexer *lexer){
-    char delimiter = lexer->src[lexer->position - 1];
-    long long start = lexer->position;
 
-    while(!isAtEnd(lexer) && peek(lexer) != delimiter){
-        if(peek(lexer) == '\\' && !isAtEnd(lexer)){
-            advance(lexer);
-        }
-        advance(lexer);
+    // Literals are typed by the smallest of int, long and long long that
+    // holds them, then ullong. They are never narrowed to short, since every
+    // small constant would then stop being an int.
+    unsigned long long val;
+    if(!parseInteger(span + prefix_offset, len - prefix_offset, base, &val)){
+        return createToken(lexer, null_token, &(token_data){0}, start);
     }
 
-    if(isAtEnd(lexer)){
-        return createToken(lexer, null_token, &(token_data){0}, "");
+    if(val <= INT_MAX){
+        data.properties.value.type = type_int;
+        data.properties.value.value.i_value = (int)val;
+        return createToken(lexer, int_literal_token, &data, start);
     }
+    if(val <= LONG_MAX){
+        data.properties.value.type = type_long;
+        data.properties.value.value.l_value = (long)val;
+        return createToken(lexer, long_literal_token, &data, start);
+    }
+    if(val <= LLONG_MAX){
+        data.properties.value.type = type_long_long;
+        data.properties.value.value.ll_value = (long long)val;
+        return createToken(lexer, long_long_literal_token, &data, start);
+    }
+    data.properties.value.type = type_ullong;
+    data.properties.value.value.ull_value = val;
+    return createToken(lexer, long_long_literal_token, &data, start);
+}
 
-    long long end = lexer->position;
-    advance(lexer);
-
-    long long max_len = end - start;
-    char *str = malloc(max_len + 1);
-    if(!str) return createToken(lexer, null_token, &(token_data){0}, "");
-
-    long long src_idx = start;
+static long long decodeEscapes(const char *src, long long length, char *str){
+    long long src_idx = 0;
     long long dest_idx = 0;
 
-    while(src_idx < end){
-        if(lexer->src[src_idx] == '\\' && src_idx + 1 < end){
+    while(src_idx < length){
+        if(src[src_idx] == '\\' && src_idx + 1 < length){
             src_idx++;
-            char escape_char = lexer->src[src_idx];
+            char escape_char = src[src_idx];
 
             switch(escape_char) {
                 case 'a': str[dest_idx++] = '\a'; break; 
@@ -233,8 +636,8 @@ token lexStr(lexer *lexer){
                 case '4': case '5': case '6': case '7': {
                     int octal_val = 0;
                     int count = 0;
-                    while(src_idx < end && count < 3 && lexer->src[src_idx] >= '0' && lexer->src[src_idx] <= '7') {
-                        octal_val = octal_val * 8 + (lexer->src[src_idx] - '0');
+                    while(src_idx < length && count < 3 && src[src_idx] >= '0' && src[src_idx] <= '7') {
+                        octal_val = octal_val * 8 + (src[src_idx] - '0');
                         src_idx++;
                         count++;
                     }
@@ -248,7 +651,7 @@ token lexStr(lexer *lexer){
                     int hex_val = 0;
                     int count = 0;
                     int val;
-                    while(src_idx < end && (val = hexValue(lexer->src[src_idx])) != -1) {
+                    while(src_idx < length && (val = hexValue(src[src_idx])) != -1) {
                         hex_val = hex_val * 16 + val;
                         src_idx++;
                         count++;
@@ -267,89 +670,136 @@ token lexStr(lexer *lexer){
                     break;
             }
         } else {
-            str[dest_idx++] = lexer->src[src_idx];
+            str[dest_idx++] = src[src_idx];
         }
         src_idx++;
     }
-    str[dest_idx] = '\0'; 
+    str[dest_idx] = '\0';
+    return dest_idx;
+}
+
+token lexStr(lexer *lexer){
+    long long token_start = lexer->position - 1;
+    char delimiter = lexer->src[token_start];
+    long long start = lexer->position;
+
+    // Only a backslash can hide the delimiter, so an escape-free literal is
+    // found by a single scan and interned straight from the source.
+    long long end = scanString(lexer->src, start, lexer->length, delimiter);
+    bool escaped = false;
+    while(end + 1 < lexer->length && lexer->src[end] == '\\'){
+        escaped = true;
+        end = scanString(lexer->src, end + 2, lexer->length, delimiter);
+    }
+
+    if(end >= lexer->length || lexer->src[end] != delimiter){
+        lexer->position = end < lexer->length && lexer->src[end] == '\0' ? end : lexer->length;
+        return createToken(lexer, null_token, &(token_data){0}, token_start);
+    }
+    lexer->position = end + 1;
+
+    const char *text = &lexer->src[start];
+    long long length = end - start;
+    const char *str;
+
+    if(!escaped){
+        str = internLiteral(text, length);
+    } else {
+        char buffer[256];
+        char *decoded = length < (long long)sizeof(buffer) ? buffer : malloc(length + 1);
+        if(!decoded) return createToken(lexer, null_token, &(token_data){0}, token_start);
+
+        long long decoded_length = decodeEscapes(text, length, decoded);
+        str = internLiteral(decoded, decoded_length);
+        if(decoded != buffer) free(decoded);
+    }
+    if(!str) return createToken(lexer, null_token, &(token_data){0}, token_start);
 
     token_data data = {0};
     data.properties.value.type = type_string;
-    data.properties.value.value.str_value = strdup(str);
+    data.properties.value.value.str_value = str;
 
-    token token = createToken(lexer, string_literal_token, &data, str);
+    return createToken(lexer, string_literal_token, &data, token_start);
+}
 
-    free(str);
-    return token;
+typedef struct {
+    const char *name;
+    int length;
+    token_type type;
+} keywordEntry;
+
+// Perfect hash over the keyword set: (first * 4 + last * 53 + length) & 127
+// is collision free, so one probe and one memcmp classify any identifier.
+#define KEYWORD_HASH(text, len) (((unsigned char)(text)[0] * 4 + (unsigned char)(text)[(len) - 1] * 53 + (len)) & 127)
+
+static const keywordEntry keywords[128] = {
+    [1] = {"else", 4, else_token},
+    [4] = {"impl", 4, impl_token},
+    [6] = {"false", 5, false_token},
+    [7] = {"long", 4, long_token},
+    [13] = {"do", 2, do_token},
+    [20] = {"return", 6, return_token},
+    [21] = {"const", 5, const_token},
+    [24] = {"null", 4, null_literal_token},
+    [27] = {"default", 7, default_token},
+    [31] = {"union", 5, union_token},
+    [33] = {"float", 5, float_token},
+    [37] = {"string", 6, string_token},
+    [41] = {"enum", 4, enum_token},
+    [43] = {"int", 3, int_token},
+    [44] = {"ulong", 5, ulong_token},
+    [45] = {"ullong", 6, ullong_token},
+    [46] = {"import", 6, import_token},
+    [52] = {"break", 5, break_token},
+    [53] = {"for", 3, for_token},
+    [61] = {"true", 4, true_token},
+    [68] = {"if", 2, if_token},
+    [73] = {"volatile", 8, volatile_token},
+    [74] = {"while", 5, while_token},
+    [81] = {"static", 6, static_token},
+    [85] = {"short", 5, short_token},
+    [86] = {"struct", 6, struct_token},
+    [89] = {"trait", 5, trait_token},
+    [90] = {"switch", 6, switch_token},
+    [92] = {"uint", 4, uint_token},
+    [94] = {"ushort", 6, ushort_token},
+    [96] = {"extern", 6, extern_token},
+    [97] = {"fun", 3, function_token},
+    [104] = {"bool", 4, bool_token},
+    [110] = {"self", 4, self_token},
+    [112] = {"sizeof", 6, sizeof_token},
+    [116] = {"typeof", 6, typeof_token},
+    [117] = {"typedef", 7, typedef_token},
+    [121] = {"case", 4, case_token},
+    [125] = {"continue", 8, continue_token},
+    [127] = {"double", 6, double_token},
+};
+
+static token_type keywordType(const char *text, long long len){
+    if(len < 2 || len > 8) return identifier_token;
+
+    const keywordEntry *entry = &keywords[KEYWORD_HASH(text, len)];
+    if(entry->length == len && memcmp(entry->name, text, len) == 0){
+        return entry->type;
+    }
+    return identifier_token;
 }
 
 token lexIdent(lexer *lexer){
     long long start = lexer->position;
-    while(isalnum(peek(lexer)) || peek(lexer) == '_'){
+    while(charIs(peek(lexer), char_ident)){
         advance(lexer);
     }
 
     long long len = lexer->position - start;
-    char *text = malloc(len + 1);
-    if(!text) return createToken(lexer, null_token, &(token_data){0}, "");
-
-    memcpy(text, &lexer->src[start], len);
-    text[len] = '\0';
-
-    token_type type = identifier_token;
-    #define keyword(str, tk) if(strcmp(text, str) == 0) type = tk;
-
-    keyword("if", if_token);
-    keyword("else", else_token);
-    keyword("switch", switch_token);
-    keyword("case", case_token);
-    keyword("default", default_token);
-    keyword("for", for_token);
-    keyword("while", while_token);
-    keyword("do", do_token);
-
-    keyword("import", import_token);
-    keyword("impl", impl_token);
-    keyword("trait", trait_token);
-    keyword("self", self_token);
-    keyword("fun", function_token);
-    keyword("return", return_token);
-    keyword("break", break_token);
-
-    keyword("continue", continue_token);
-    keyword("const", const_token);
-    keyword("static", static_token);
-    keyword("extern", extern_token);
-    keyword("volatile", volatile_token);
-
-    keyword("bool", bool_token);
-    keyword("true", true_token);
-    keyword("false", false_token);
-    keyword("null", null_literal_token);
-
-    keyword("short", short_token);
-    keyword("ushort", ushort_token);
-    keyword("int", int_token);
-    keyword("uint", uint_token);
-    keyword("long", long_token);
-    keyword("ulong", ullong_token);
-    keyword("ullong", ullong_token);
-    keyword("float", float_token);
-    keyword("double", double_token);
-    keyword("string", string_token);
-    keyword("typedef", typedef_token);
-    keyword("struct", struct_token);
-    keyword("enum", enum_token);
-    keyword("union", union_token);
-    
-    keyword("sizeof", sizeof_token);
-    keyword("typeof", typeof_token);
-
-    #undef keyword
+    const char *text = &lexer->src[start];
+
+    token_type type = keywordType(text, len);
 
     token_data data = {0};
     if(type == identifier_token){
-        data.identifier = strdup(text);
+        // A cut identifier is never interned: it would stay in the table.
+        if(lexer->intern && tokenComplete(lexer)) data.identifier = internAtom(text, len);
     } else if(type == true_token){
         data.properties.value.type = type_bool;
         data.properties.value.value.b_value = 1;
@@ -358,29 +808,123 @@ token lexIdent(lexer *lexer){
         data.properties.value.value.b_value = 0;
     }
 
-    token token = createToken(lexer, type, &data, text);
-    free(text);
-    return token;
+    return createToken(lexer, type, &data, start);
 }
 
-token nextToken(lexer *lexer){
-    skipWhiteSpace(lexer);
+// Operator bytes are numbered so the pair table stays small.
+enum {
+    op_none,
+    op_plus,
+    op_minus,
+    op_star,
+    op_slash,
+    op_percent,
+    op_equal,
+    op_bang,
+    op_greater,
+    op_less,
+    op_and,
+    op_or,
+    op_caret,
+    op_tilde,
+    op_l_paren,
+    op_r_paren,
+    op_l_bracket,
+    op_r_bracket,
+    op_l_brace,
+    op_r_brace,
+    op_comma,
+    op_dot,
+    op_semicolon,
+    op_colon,
+    op_count
+};
+
+static const unsigned char operatorIndex[256] = {
+    ['+'] = op_plus, ['-'] = op_minus, ['*'] = op_star, ['/'] = op_slash,
+    ['%'] = op_percent, ['='] = op_equal, ['!'] = op_bang, ['>'] = op_greater,
+    ['<'] = op_less, ['&'] = op_and, ['|'] = op_or, ['^'] = op_caret,
+    ['~'] = op_tilde, ['('] = op_l_paren, [')'] = op_r_paren, ['['] = op_l_bracket,
+    [']'] = op_r_bracket, ['{'] = op_l_brace, ['}'] = op_r_brace, [','] = op_comma,
+    ['.'] = op_dot, [';'] = op_semicolon, [':'] = op_colon,
+};
+
+static const unsigned char operatorSingle[op_count] = {
+    [op_plus] = plus_token, [op_minus] = minus_token, [op_star] = star_token,
+    [op_slash] = slash_token, [op_percent] = percent_token, [op_equal] = equal_token,
+    [op_bang] = not_token, [op_greater] = greater_token, [op_less] = less_token,
+    [op_and] = address_token, [op_or] = bitwise_or_token, [op_caret] = bitwise_xor_token,
+    [op_tilde] = bitwise_not_token, [op_l_paren] = l_paren_token, [op_r_paren] = r_paren_token,
+    [op_l_bracket] = l_bracket_token, [op_r_bracket] = r_bracket_token, [op_l_brace] = l_brace_token,
+    [op_r_brace] = r_brace_token, [op_comma] = comma_token, [op_dot] = dot_token,
+    [op_semicolon] = semicolon_token, [op_colon] = colon_token,
+};
+
+// Zero (identifier_token) marks pairs that are not an operator. ".." only
+// stands for the start of "...".
+static const unsigned char operatorPair[op_count][op_count] = {
+    [op_plus] = {[op_plus] = increment_token, [op_equal] = plus_equal_token},
+    [op_minus] = {[op_minus] = decrement_token, [op_greater] = arrow_token, [op_equal] = minus_equal_token},
+    [op_star] = {[op_equal] = star_equal_token},
+    [op_slash] = {[op_equal] = slash_equal_token},
+    [op_percent] = {[op_equal] = percent_equal_token},
+    [op_equal] = {[op_equal] = equal_equal_token},
+    [op_bang] = {[op_equal] = not_equal_token},
+    [op_greater] = {[op_greater] = shift_right_token, [op_equal] = greater_equal_token},
+    [op_less] = {[op_less] = shift_left_token, [op_equal] = less_equal_token},
+    [op_and] = {[op_and] = and_token, [op_equal] = and_equal_token},
+    [op_or] = {[op_or] = or_token, [op_equal] = or_equal_token},
+    [op_caret] = {[op_equal] = xor_equal_token},
+    [op_dot] = {[op_dot] = ellipsis_token},
+};
+
+// Operators come out of two table loads. The three-byte ones all extend a
+// pair: ">>" and "<<" may take a '=', and ".." is only an operator as "...".
+static token lexOperator(lexer *lexer, long long start){
+    const unsigned char *src = (const unsigned char *)&lexer->src[start];
+    int first = operatorIndex[src[0]];
+    token_type type = operatorSingle[first];
+    int length = 1;
+
+    token_type pair = operatorPair[first][operatorIndex[src[1]]];
+    if(pair){
+        type = pair;
+        length = 2;
+
+        if(type == shift_right_token || type == shift_left_token){
+            if(src[2] == '='){
+                type = type == shift_right_token ? shift_right_equal_token : shift_left_equal_token;
+                length = 3;
+            }
+        } else if(type == ellipsis_token){
+            if(src[2] == '.'){
+                length = 3;
+            } else {
+                type = dot_token;
+                length = 1;
+            }
+        }
+    }
 
+    lexer->position = start + length;
+    return createToken(lexer, type, &(token_data){0}, start);
+}
+
+static token lexToken(lexer *lexer){
+    long long start = lexer->position;
     if(isAtEnd(lexer)){
-        return createToken(lexer, eof_token, &(token_data){0}, "");
+        return createToken(lexer, eof_token, &(token_data){0}, start);
     }
 
     char current = advance(lexer);
 
-    if(isalpha(current) || current == '_'){
+    if(charIs(current, char_ident_start)){
         lexer->position--;
-        lexer->column--;
         return lexIdent(lexer);
     }
 
-    if(isdigit(current)){
+    if(charIs(current, char_digit)){
         lexer->position--;
-        lexer->column--;
         return lexNums(lexer);
     }
 
@@ -388,115 +932,599 @@ token nextToken(lexer *lexer){
         return lexStr(lexer);
     }
 
-    switch(current){
-        case '+':
-            if(match(lexer, '+')) return createToken(lexer, increment_token, &(token_data){0}, "++");
-            if(match(lexer, '=')) return createToken(lexer, plus_equal_token, &(token_data){0}, "+=");
-            return createToken(lexer, plus_token, &(token_data){0}, "+");
-        case '-':
-            if(match(lexer, '-')) return createToken(lexer, decrement_token, &(token_data){0}, "--");
-            if(match(lexer, '>')) return createToken(lexer, arrow_token, &(token_data){0}, "->");
-            if(match(lexer, '=')) return createToken(lexer, minus_equal_token, &(token_data){0}, "-=");
-            return createToken(lexer, minus_token, &(token_data){0}, "-");
-        case '*':
-            if(match(lexer, '=')) return createToken(lexer, star_equal_token, &(token_data){0}, "*=");
-            return createToken(lexer, star_token, &(token_data){0}, "*");
-        case '/':
-            if(match(lexer, '=')) return createToken(lexer, slash_equal_token, &(token_data){0}, "/=");
-            return createToken(lexer, slash_token, &(token_data){0}, "/");
-        case '%':
-            if(match(lexer, '=')) return createToken(lexer, percent_equal_token, &(token_data){0}, "%=");
-            return createToken(lexer, percent_token, &(token_data){0}, "%");
-        case '=':
-            if(match(lexer, '=')) return createToken(lexer, equal_equal_token, &(token_data){0}, "==");
-            return createToken(lexer, equal_token, &(token_data){0}, "=");
-        case '!':
-            if(match(lexer, '=')) return createToken(lexer, not_equal_token, &(token_data){0}, "!=");
-            return createToken(lexer, not_token, &(token_data){0}, "!");
-        case '>':
-            if(match(lexer, '>')){
-                if(match(lexer, '=')) return createToken(lexer, shift_right_equal_token, &(token_data){0}, ">>=");
-                return createToken(lexer, shift_right_token, &(token_data){0}, ">>");
-            }
-            if(match(lexer, '=')) return createToken(lexer, greater_equal_token, &(token_data){0}, ">=");
-            return createToken(lexer, greater_token, &(token_data){0}, ">");
-        case '<':
-            if(match(lexer, '<')){
-                if(match(lexer, '=')) return createToken(lexer, shift_left_equal_token, &(token_data){0}, "<<=");
-                return createToken(lexer, shift_left_token, &(token_data){0}, "<<");
-            }
-            if(match(lexer, '=')) return createToken(lexer, less_equal_token, &(token_data){0}, "<=");
-            return createToken(lexer, less_token, &(token_data){0}, "<");
-        case '&':
-            if(match(lexer, '&')) return createToken(lexer, and_token, &(token_data){0}, "&&");
-            if(match(lexer, '=')) return createToken(lexer, and_equal_token, &(token_data){0}, "&=");
-            return createToken(lexer, address_token, &(token_data){0}, "&");
-        case '|':
-            if(match(lexer, '|')) return createToken(lexer, or_token, &(token_data){0}, "||");
-            if(match(lexer, '=')) return createToken(lexer, or_equal_token, &(token_data){0}, "|=");
-            return createToken(lexer, bitwise_or_token, &(token_data){0}, "|");
-        case '^':
-            if(match(lexer, '=')) return createToken(lexer, xor_equal_token, &(token_data){0}, "^=");
-            return createToken(lexer, bitwise_xor_token, &(token_data){0}, "^");
-        case '~':
-            return createToken(lexer, bitwise_not_token, &(token_data){0}, "~");
-        case '(':
-            return createToken(lexer, l_paren_token, &(token_data){0}, "(");
-        case ')':
-            return createToken(lexer, r_paren_token, &(token_data){0}, ")");
-        case '[':
-            return createToken(lexer, l_bracket_token, &(token_data){0}, "[");
-        case ']':
-            return createToken(lexer, r_bracket_token, &(token_data){0}, "]");
-        case '{':
-            return createToken(lexer, l_brace_token, &(token_data){0}, "{");
-        case '}':
-            return createToken(lexer, r_brace_token, &(token_data){0}, "}");
-        case ',':
-            return createToken(lexer, comma_token, &(token_data){0}, ",");
-        case '.':
-            if(peek(lexer) == '.' && peekNext(lexer) == '.'){
-                advance(lexer);
-                advance(lexer);
-                return createToken(lexer, ellipsis_token, &(token_data){0}, "...");
-            }
-            return createToken(lexer, dot_token, &(token_data){0}, ".");
-        case ';':
-            return createToken(lexer, semicolon_token, &(token_data){0}, ";");
-        case ':':
-            return createToken(lexer, colon_token, &(token_data){0}, ":");
-        default:
-            return createToken(lexer, null_token, &(token_data){0}, "");
+    if(!charIs(current, char_operator)){
+        return createToken(lexer, null_token, &(token_data){0}, start);
     }
+    return lexOperator(lexer, start);
+}
+
+// Doubles the window of a stream lexer whose current token fills all of it.
+static bool growWindow(lexer *lexer){
+    char *window = realloc((char *)lexer->src, lexer->capacity * 2 + 1);
+    if(!window) return false;
+    lexer->src = window;
+    lexer->capacity *= 2;
+    return true;
+}
+
+token nextToken(lexer *lexer){
+    skipWhiteSpace(lexer);
+    reserveWindow(lexer, lexer->capacity / 2);
+    if(lexer->source != source_stream) return lexToken(lexer);
+
+    // A token that runs into the end of the window may continue past it, so
+    // it is lexed again once more input is in. The window only grows when the
+    // token already starts at its front, so memory stays bounded by the
+    // largest token.
+    while(1){
+        long long start = lexer->position;
+        token token = lexToken(lexer);
+        if(tokenComplete(lexer)) return token;
+
+        lexer->position = start;
+        if(start == 0 && !growWindow(lexer)){
+            return createToken(lexer, null_token, &(token_data){0}, start);
+        }
+        refillWindow(lexer);
+    }
+}
+
+static void resetLexer(lexer *lexer){
+    lexer->base = 0;
+    lexer->capacity = 0;
+    lexer->fd = -1;
+    lexer->stream_eof = true;
+    lexer->position = 0;
+    lexer->line_starts = NULL;
+    lexer->line_count = 0;
+    lexer->base_line = 1;
+    lexer->base_line_start = 0;
+    lexer->intern = true;
 }
 
 void initLexer(lexer *lexer, char *src){
+    lexer->length = strlen(src);
     lexer->src = strdup(src);
-    lexer->position = 0;
-    lexer->column = 1;
-    lexer->line = 1;
+    lexer->source = source_owned;
+    lexer->mapped_size = 0;
+    resetLexer(lexer);
+}
+
+void initLexerBorrowed(lexer *lexer, const char *src, long long length){
+    lexer->src = src;
+    lexer->length = length;
+    lexer->source = source_borrowed;
+    lexer->mapped_size = 0;
+    resetLexer(lexer);
+}
+
+bool initLexerFromFile(lexer *lexer, const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)){
+        close(fd);
+        return false;
+    }
+
+    // Reserve one zero-filled page past the end of the file and map the file
+    // over the front of it, so src[length] is always a readable '\0' even
+    // when the file size is an exact multiple of the page size.
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = (size_t)st.st_size;
+    size_t mapped_size = (length + page) & ~(page - 1);
+
+    char *base = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){
+        close(fd);
+        return false;
+    }
+
+    if(length > 0){
+        if(mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+            munmap(base, mapped_size);
+            close(fd);
+            return false;
+        }
+        posix_madvise(base, length, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    lexer->src = base;
+    lexer->length = (long long)length;
+    lexer->source = source_mapped;
+    lexer->mapped_size = mapped_size;
+    resetLexer(lexer);
+    return true;
+}
+
+bool initLexerStream(lexer *lexer, int fd, long long window_size){
+    if(window_size < 2) return false;
+
+    char *window = malloc(window_size + 1);
+    if(!window) return false;
+    window[0] = '\0';
+
+    lexer->src = window;
+    lexer->length = 0;
+    lexer->source = source_stream;
+    lexer->mapped_size = 0;
+    resetLexer(lexer);
+    lexer->capacity = window_size;
+    lexer->fd = fd;
+    lexer->stream_eof = false;
+
+    refillWindow(lexer);
+    return true;
 }
 
 void freeLexer(lexer *lexer){
-    free(lexer->src);
+    if(lexer->source == source_owned || lexer->source == source_stream){
+        free((char *)lexer->src);
+    } else if(lexer->source == source_mapped){
+        munmap((char *)lexer->src, lexer->mapped_size);
+    }
     lexer->src = NULL;
+
+    free(lexer->line_starts);
+    lexer->line_starts = NULL;
+    lexer->line_count = 0;
+}
+
+static bool buildLineIndex(lexer *lexer){
+    long count = scanNewlines(lexer->src, 0, lexer->length, NULL);
+    long long *starts = malloc((count + 1) * sizeof(long long));
+    if(!starts) return false;
+
+    starts[0] = 0;
+    scanNewlines(lexer->src, 0, lexer->length, &starts[1]);
+    lexer->line_starts = starts;
+    lexer->line_count = count + 1;
+    return true;
+}
+
+bool lexerPosition(lexer *lexer, long long offset, long *line, long *column){
+    if(lexer->source == source_stream){
+        if(offset < lexer->base || offset > lexer->base + lexer->length) return false;
+
+        long long end = offset - lexer->base;
+        long newlines = scanNewlines(lexer->src, 0, end, NULL);
+        long long line_start = lexer->base_line_start;
+        if(newlines){
+            long long last = end - 1;
+            while(lexer->src[last] != '\n') last--;
+            line_start = lexer->base + last + 1;
+        }
+        *line = lexer->base_line + newlines;
+        *column = (long)(offset - line_start + 1);
+        return true;
+    }
+
+    if(offset < 0 || offset > lexer->length) return false;
+    if(!lexer->line_starts && !buildLineIndex(lexer)) return false;
+
+    long low = 0;
+    long high = lexer->line_count - 1;
+    while(low < high){
+        long mid = (low + high + 1) / 2;
+        if(lexer->line_starts[mid] <= offset){
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    *line = low + 1;
+    *column = (long)(offset - lexer->line_starts[low] + 1);
+    return true;
 }
 
 void freeToken(token *t) {
-    if (t->lexeme != NULL) {
-        free(t->lexeme);
-        t->lexeme = NULL;
+    (void)t;
+}
+
+static bool hasLiteral(token_type type){
+    switch(type){
+        case short_literal_token:
+        case int_literal_token:
+        case long_literal_token:
+        case long_long_literal_token:
+        case float_literal_token:
+        case long_double_literal_token:
+        case string_literal_token:
+        case true_token:
+        case false_token:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool growTokenBuffer(tokenBuffer *buffer){
+    int capacity = buffer->capacity ? buffer->capacity * 2 : 1024;
+
+    uint8_t *kind = realloc(buffer->kind, capacity * sizeof(uint8_t));
+    if(!kind) return false;
+    buffer->kind = kind;
+
+    uint32_t *offset = realloc(buffer->offset, capacity * sizeof(uint32_t));
+    if(!offset) return false;
+    buffer->offset = offset;
+
+    uint32_t *length = realloc(buffer->length, capacity * sizeof(uint32_t));
+    if(!length) return false;
+    buffer->length = length;
+
+    buffer->capacity = capacity;
+    return true;
+}
+
+static bool pushLiteral(tokenBuffer *buffer, uint32_t index, dataValue *value){
+    if(buffer->literal_count == buffer->literal_capacity){
+        int capacity = buffer->literal_capacity ? buffer->literal_capacity * 2 : 256;
+        tokenLiteral *literals = realloc(buffer->literals, capacity * sizeof(tokenLiteral));
+        if(!literals) return false;
+
+        buffer->literals = literals;
+        buffer->literal_capacity = capacity;
+    }
+    buffer->literals[buffer->literal_count].index = index;
+    buffer->literals[buffer->literal_count].value = *value;
+    buffer->literal_count++;
+    return true;
+}
+
+static bool appendToken(tokenBuffer *buffer, token_type type, long long start, int length, dataValue *value){
+    if(buffer->count == buffer->capacity && !growTokenBuffer(buffer)) return false;
+
+    int index = buffer->count;
+    if(hasLiteral(type) && !pushLiteral(buffer, index, value)) return false;
+
+    buffer->kind[index] = (uint8_t)type;
+    buffer->offset[index] = (uint32_t)start;
+    buffer->length[index] = (uint32_t)length;
+    buffer->count++;
+    return true;
+}
+
+bool lexAll(lexer *lexer, tokenBuffer *buffer){
+    memset(buffer, 0, sizeof(tokenBuffer));
+    if(lexer->source == source_stream || lexer->length > UINT32_MAX) return false;
+
+    bool intern = lexer->intern;
+    lexer->intern = false;
+
+    while(1){
+        token t = nextToken(lexer);
+        if(!appendToken(buffer, t.type, t.start, t.length, &t.data.properties.value)){
+            freeTokenBuffer(buffer);
+            lexer->intern = intern;
+            return false;
+        }
+        if(t.type == eof_token){
+            lexer->intern = intern;
+            return true;
+        }
+    }
+}
+
+token tokenAt(tokenBuffer *buffer, int index){
+    if(index >= buffer->count) index = buffer->count - 1;
+
+    token t = {0};
+    t.type = (token_type)buffer->kind[index];
+    t.start = buffer->offset[index];
+    t.length = (int)buffer->length[index];
+
+    if(hasLiteral(t.type)){
+        int low = 0;
+        int high = buffer->literal_count - 1;
+        while(low <= high){
+            int mid = (low + high) / 2;
+            if(buffer->literals[mid].index < (uint32_t)index){
+                low = mid + 1;
+            } else if(buffer->literals[mid].index > (uint32_t)index){
+                high = mid - 1;
+            } else {
+                t.data.properties.value = buffer->literals[mid].value;
+                break;
+            }
+        }
+    }
+    return t;
+}
+
+void freeTokenBuffer(tokenBuffer *buffer){
+    free(buffer->kind);
+    free(buffer->offset);
+    free(buffer->length);
+    free(buffer->literals);
+    memset(buffer, 0, sizeof(tokenBuffer));
+}
+
+// Parallel lexing splits the input into chunks that start after a newline
+// and lexes each one speculatively from its first byte. A chunk may begin
+// inside a string or comment, so the stitch pass lexes serially from where
+// the accepted stream ends until it produces a token starting at the same
+// offset as one of the chunk's tokens. Token boundaries depend only on the
+// offset lexing starts from, so every later token of that chunk is what the
+// serial lexer would have produced and is adopted as is.
+#define PARALLEL_MIN_CHUNK (1 << 20)
+
+typedef struct {
+    const char *src;
+    long long length;
+    long long start;
+    long long end;
+    long long resume;
+    tokenBuffer tokens;
+    bool ok;
+} lexChunk;
+
+static void *lexChunkWorker(void *arg){
+    lexChunk *chunk = arg;
+    lexer lexer;
+    initLexerBorrowed(&lexer, chunk->src, chunk->length);
+    lexer.position = chunk->start;
+    lexer.intern = false;
+    chunk->ok = true;
+
+    while(1){
+        token t = nextToken(&lexer);
+        if(t.start >= chunk->end && t.type != eof_token) break;
+        if(!appendToken(&chunk->tokens, t.type, t.start, t.length, &t.data.properties.value)){
+            chunk->ok = false;
+            break;
+        }
+        chunk->resume = lexer.position;
+        if(t.type == eof_token) break;
+    }
+    freeLexer(&lexer);
+    return NULL;
+}
+
+static int firstTokenAt(tokenBuffer *buffer, int from, long long offset){
+    int low = from;
+    int high = buffer->count;
+    while(low < high){
+        int mid = (low + high) / 2;
+        if(buffer->offset[mid] < offset){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Copies tokens [from, count) of a chunk to the end of buffer.
+static bool adoptTokens(tokenBuffer *buffer, tokenBuffer *chunk, int from){
+    int count = chunk->count - from;
+    while(buffer->capacity - buffer->count < count){
+        if(!growTokenBuffer(buffer)) return false;
+    }
+
+    int literal = 0;
+    while(literal < chunk->literal_count && chunk->literals[literal].index < (uint32_t)from) literal++;
+    for(int i = literal; i < chunk->literal_count; i++){
+        uint32_t index = chunk->literals[i].index - from + buffer->count;
+        if(!pushLiteral(buffer, index, &chunk->literals[i].value)) return false;
+    }
+
+    memcpy(&buffer->kind[buffer->count], &chunk->kind[from], count * sizeof(uint8_t));
+    memcpy(&buffer->offset[buffer->count], &chunk->offset[from], count * sizeof(uint32_t));
+    memcpy(&buffer->length[buffer->count], &chunk->length[from], count * sizeof(uint32_t));
+    buffer->count += count;
+    return true;
+}
+
+bool lexAllParallel(lexer *lexer, tokenBuffer *buffer, int threads){
+    if(threads <= 1 || lexer->source == source_stream || lexer->length > UINT32_MAX || lexer->length - lexer->position < (long long)threads * PARALLEL_MIN_CHUNK){
+        return lexAll(lexer, buffer);
+    }
+    resolveScanners();
+
+    lexChunk *chunks = calloc(threads, sizeof(lexChunk));
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    if(!chunks || !workers){
+        free(chunks);
+        free(workers);
+        return false;
+    }
+
+    long long step = (lexer->length - lexer->position) / threads;
+    for(int i = 0; i < threads; i++){
+        long long start = lexer->position;
+        if(i > 0){
+            start = chunks[i - 1].start + step;
+            const char *newline = NULL;
+            if(start < lexer->length) newline = memchr(&lexer->src[start], '\n', lexer->length - start);
+            start = newline ? newline - lexer->src + 1 : lexer->length;
+        }
+        chunks[i].src = lexer->src;
+        chunks[i].length = lexer->length;
+        chunks[i].start = start;
+        if(i > 0) chunks[i - 1].end = start;
+    }
+    chunks[threads - 1].end = lexer->length;
+
+    int started = 0;
+    bool ok = true;
+    for(; started < threads; started++){
+        if(pthread_create(&workers[started], NULL, lexChunkWorker, &chunks[started]) != 0) break;
+    }
+    for(int i = started; i < threads; i++) lexChunkWorker(&chunks[i]);
+    for(int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    for(int i = 0; i < threads; i++) ok = ok && chunks[i].ok;
+
+    memset(buffer, 0, sizeof(tokenBuffer));
+    long long position = lexer->position;
+    bool done = false;
+    bool intern = lexer->intern;
+    lexer->intern = false;
+
+    for(int i = 0; i <= threads && ok && !done; i++){
+        tokenBuffer *chunk = i < threads ? &chunks[i].tokens : NULL;
+        int from = 0;
+
+        while(ok && !done){
+            if(chunk){
+                from = firstTokenAt(chunk, from, position);
+                if(from == chunk->count) break;
+            }
+
+            lexer->position = position;
+            token t = nextToken(lexer);
+
+            if(chunk && t.start == chunk->offset[from]){
+                ok = adoptTokens(buffer, chunk, from);
+                position = chunks[i].resume;
+                done = buffer->kind[buffer->count - 1] == eof_token;
+                break;
+            }
+
+            if(!appendToken(buffer, t.type, t.start, t.length, &t.data.properties.value)){
+                ok = false;
+                break;
+            }
+            position = lexer->position;
+            done = t.type == eof_token;
+        }
     }
+    lexer->position = position;
+    lexer->intern = intern;
 
-    if (t->type == identifier_token && t->data.identifier != NULL) {
-        free(t->data.identifier);
-        t->data.identifier = NULL;
+    for(int i = 0; i < threads; i++) freeTokenBuffer(&chunks[i].tokens);
+    free(chunks);
+    free(workers);
+
+    if(!ok){
+        freeTokenBuffer(buffer);
+        return false;
     }
+    return true;
+}
+// Incremental relexing reuses the property the stitch pass relies on: once
+// the new stream produces a token at the same place an old token after the
+// edit moved to, every following token is the old one shifted by the edit.
+// A token depends on its own bytes and at most two after it ('1' before
+// ".5", '.' before ".."), so tokens ending that far before the edit are kept.
+#define RELEX_LOOKAHEAD 2
 
-    if (t->type == string_literal_token) {
-        if (t->data.properties.value.value.str_value != NULL) {
-            free(t->data.properties.value.value.str_value);
-            t->data.properties.value.value.str_value = NULL;
+static bool applyEdit(lexer *lexer, long long offset, long long removed, const char *inserted, long long inserted_length){
+    long long length = lexer->length - removed + inserted_length;
+    char *src = (char *)lexer->src;
+
+    if(length > lexer->length){
+        src = realloc(src, length + 1);
+        if(!src) return false;
+    }
+    memmove(&src[offset + inserted_length], &src[offset + removed], lexer->length - offset - removed + 1);
+    memcpy(&src[offset], inserted, inserted_length);
+
+    lexer->src = src;
+    lexer->length = length;
+    free(lexer->line_starts);
+    lexer->line_starts = NULL;
+    lexer->line_count = 0;
+    return true;
+}
+
+// Replaces tokens [first, last) of buffer with the tokens in fresh and moves
+// every later token by delta bytes.
+static bool spliceTokens(tokenBuffer *buffer, int first, int last, tokenBuffer *fresh, long long delta){
+    int shift = fresh->count - (last - first);
+    while(buffer->capacity < buffer->count + shift){
+        if(!growTokenBuffer(buffer)) return false;
+    }
+
+    int first_literal = 0;
+    while(first_literal < buffer->literal_count && buffer->literals[first_literal].index < (uint32_t)first) first_literal++;
+    int last_literal = first_literal;
+    while(last_literal < buffer->literal_count && buffer->literals[last_literal].index < (uint32_t)last) last_literal++;
+
+    int literal_count = buffer->literal_count - (last_literal - first_literal) + fresh->literal_count;
+    if(literal_count > buffer->literal_capacity){
+        tokenLiteral *literals = realloc(buffer->literals, literal_count * sizeof(tokenLiteral));
+        if(!literals) return false;
+
+        buffer->literals = literals;
+        buffer->literal_capacity = literal_count;
+    }
+
+    int tail = buffer->count - last;
+    memmove(&buffer->kind[last + shift], &buffer->kind[last], tail * sizeof(uint8_t));
+    memmove(&buffer->offset[last + shift], &buffer->offset[last], tail * sizeof(uint32_t));
+    memmove(&buffer->length[last + shift], &buffer->length[last], tail * sizeof(uint32_t));
+    if(fresh->count > 0){
+        memcpy(&buffer->kind[first], fresh->kind, fresh->count * sizeof(uint8_t));
+        memcpy(&buffer->offset[first], fresh->offset, fresh->count * sizeof(uint32_t));
+        memcpy(&buffer->length[first], fresh->length, fresh->count * sizeof(uint32_t));
+    }
+    buffer->count += shift;
+    for(int i = first + fresh->count; i < buffer->count; i++) buffer->offset[i] += (uint32_t)delta;
+
+    int literal_tail = buffer->literal_count - last_literal;
+    if(literal_tail > 0) memmove(&buffer->literals[first_literal + fresh->literal_count], &buffer->literals[last_literal], literal_tail * sizeof(tokenLiteral));
+    for(int i = 0; i < fresh->literal_count; i++){
+        buffer->literals[first_literal + i] = fresh->literals[i];
+        buffer->literals[first_literal + i].index += first;
+    }
+    buffer->literal_count = literal_count;
+    for(int i = first_literal + fresh->literal_count; i < literal_count; i++) buffer->literals[i].index += shift;
+    return true;
+}
+
+bool relexEdit(lexer *lexer, tokenBuffer *buffer, long long offset, long long removed, const char *inserted, long long inserted_length, tokenRange *changed){
+    if(lexer->source != source_owned || buffer->count == 0) return false;
+    if(offset < 0 || removed < 0 || inserted_length < 0 || offset > lexer->length || removed > lexer->length - offset) return false;
+    if(lexer->length - removed + inserted_length > UINT32_MAX) return false;
+    if(!applyEdit(lexer, offset, removed, inserted, inserted_length)) return false;
+
+    long long delta = inserted_length - removed;
+    int first = 0;
+    int high = buffer->count - 1;
+    while(first < high){
+        int mid = (first + high) / 2;
+        if((long long)buffer->offset[mid] + buffer->length[mid] + RELEX_LOOKAHEAD <= offset){
+            first = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // Old tokens from here on start after the edit, so they may match again.
+    int old = firstTokenAt(buffer, first, offset + removed);
+
+    tokenBuffer fresh = {0};
+    bool intern = lexer->intern;
+    lexer->intern = false;
+    lexer->position = first > 0 ? buffer->offset[first - 1] + buffer->length[first - 1] : 0;
+
+    bool ok = true;
+    while(1){
+        token t = nextToken(lexer);
+        while(old < buffer->count && buffer->offset[old] + delta < t.start) old++;
+        if(old < buffer->count && buffer->offset[old] + delta == t.start) break;
+
+        if(!appendToken(&fresh, t.type, t.start, t.length, &t.data.properties.value)){
+            ok = false;
+            break;
+        }
+        if(t.type == eof_token){
+            old = buffer->count;
+            break;
         }
     }
-}
\ No newline at end of file
+    lexer->intern = intern;
+    lexer->position = lexer->length;
+
+    ok = ok && spliceTokens(buffer, first, old, &fresh, delta);
+    if(ok && changed){
+        changed->first = first;
+        changed->old_end = old;
+        changed->new_end = first + fresh.count;
+    }
+    freeTokenBuffer(&fresh);
+    return ok;
+}
@@ -2,6 +2,10 @@
 #define LEXER_H
 
 #include "ast.h"
+#include "atom.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef enum {
     identifier_token,           // lorem_isum
@@ -105,11 +109,38 @@ typedef enum {
     eof_token
 } token_type;
 
+typedef enum {
+    source_owned,       // strdup'd by initLexer
+    source_mapped,      // mmap'd by initLexerFromFile
+    source_borrowed,    // owned by the caller
+    source_stream       // refillable window over a file descriptor
+} sourceKind;
+
+// src[length] is always '\0': the lexer relies on that sentinel.
+// For streams src is a window that starts at byte offset base of the input;
+// other sources have base 0 and hold the whole input.
 typedef struct {
-    char *src;
+    const char *src;
+    long long length;
     long long position;
-    long line;
-    long column;
+    sourceKind source;
+    size_t mapped_size;
+    long long base;
+    long long capacity;
+    int fd;
+    bool stream_eof;
+
+    // Line information is only computed when asked for. line_starts holds the
+    // offset of every line start and is built on the first lexerPosition call.
+    // Streams instead remember the line number and start offset of src[0].
+    long long *line_starts;
+    long line_count;
+    long base_line;
+    long long base_line_start;
+
+    // Identifier tokens carry their atom unless this is off. Batch lexing
+    // turns it off since the token buffer has nowhere to keep them.
+    bool intern;
 } lexer;
 
 typedef union {
@@ -117,22 +148,75 @@ typedef union {
         dataValue value;
         dataType type;
     } properties;
-
-    char *identifier;
+    atom identifier;
 } token_data;
 
+// The lexeme is not copied: start and length describe a span of the input,
+// which stays valid for as long as the lexer does. For streaming lexers the
+// span is only guaranteed until the next call to nextToken.
 typedef struct {
     token_type type;
+    int length;
+    long long start;
     token_data data;
-    char *lexeme;
-    int line;
-    int column;
 } token;
 
-token createToken(lexer *lexer, token_type type, token_data *data, char *lexeme);
+typedef struct {
+    uint32_t index;
+    dataValue value;
+} tokenLiteral;
+
+// A whole input lexed up front, stored as parallel arrays. Only tokens that
+// carry a value get an entry in literals, kept sorted by token index.
+typedef struct {
+    uint8_t *kind;
+    uint32_t *offset;
+    uint32_t *length;
+    int count;
+    int capacity;
+
+    tokenLiteral *literals;
+    int literal_count;
+    int literal_capacity;
+} tokenBuffer;
+
+// Tokens [first, old_end) of the buffer before an edit were replaced by
+// tokens [first, new_end); the ones after only moved.
+typedef struct {
+    int first;
+    int old_end;
+    int new_end;
+} tokenRange;
+
+token createToken(lexer *lexer, token_type type, token_data *data, long long start);
+const char *tokenLexeme(lexer *lexer, token *token);
+char *copyLexeme(lexer *lexer, token *token);
 token nextToken(lexer *lexer);
 void initLexer(lexer *lexer, char *src);
+// The caller keeps src alive for the lexer's lifetime and guarantees src[length] == '\0'.
+void initLexerBorrowed(lexer *lexer, const char *src, long long length);
+bool initLexerFromFile(lexer *lexer, const char *path);
+// Lexes fd through a window of window_size bytes. The window grows to hold a
+// longer token, so memory stays bounded by the window or the largest token.
+bool initLexerStream(lexer *lexer, int fd, long long window_size);
 void freeLexer(lexer *lexer);
+// Tokens own no memory: decoded string literals live in the literal pool
+// (atom.h). This is a no-op kept for existing callers.
 void freeToken(token *token);
+// 1-based line and column of a byte offset. Streams can only answer for
+// offsets still inside the window.
+bool lexerPosition(lexer *lexer, long long offset, long *line, long *column);
+
+// lexAll needs the whole input in memory, so it does not accept stream lexers.
+bool lexAll(lexer *lexer, tokenBuffer *buffer);
+// Same result as lexAll, with the input split across up to threads workers.
+bool lexAllParallel(lexer *lexer, tokenBuffer *buffer, int threads);
+token tokenAt(tokenBuffer *buffer, int index);
+// Replaces removed bytes at offset with inserted in the lexer's own copy of
+// the input (initLexer) and brings buffer, lexed from the old input, up to
+// date by relexing only around the edit. changed may be NULL. On failure the
+// input may already be edited; lexAll again to recover.
+bool relexEdit(lexer *lexer, tokenBuffer *buffer, long long offset, long long removed, const char *inserted, long long inserted_length, tokenRange *changed);
+void freeTokenBuffer(tokenBuffer *buffer);
 
 #endif
\ No newline at end of file
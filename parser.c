@@ -1,20 +1,11 @@
 #include "parser.h"
+#include <pthread.h>
 
 // Forward declarations
-astNode *parseAssignment(parser *parser);
 astNode *parsePrimary(parser *parser);
 astNode *parsePostfix(parser *parser);
 astNode *parseUnary(parser *parser);
-astNode *parseMultiplicative(parser *parser);
-astNode *parseAdditive(parser *parser);
-astNode *parseRelational(parser *parser);
-astNode *parseEquality(parser *parser);
-astNode *parseLogicalAnd(parser *parser);
-astNode *parseLogicalOr(parser *parser);
-astNode *parseShift(parser *parser);
-astNode *parseBitwiseAnd(parser *parser);
-astNode *parseBitwiseXor(parser *parser);
-astNode *parseBitwiseOr(parser *parser);
+astNode *parseBinary(parser *parser, int min_power);
 astNode *parseReturnStatement(parser *parser);
 astNode *parseContinueStatement(parser *parser);
 astNode *parseBreakStatement(parser *parser);
@@ -39,79 +30,180 @@ astNode *parseParamList(parser *parser, int *is_variadic);
 astNode *parseType(parser *parser);
 dataFlags parseFlags(parser *parser);
 static int isTypeToken(token_type type);
-static token_type peekNextTokenType(parser *parser);
+static long long matchBrace(const char *src, long long position, long long length);
+
+// Binding powers of infix operators, loosest first.
+enum {
+    bind_none,
+    bind_assignment,
+    bind_or,
+    bind_and,
+    bind_bitwise_or,
+    bind_bitwise_xor,
+    bind_bitwise_and,
+    bind_equality,
+    bind_relational,
+    bind_shift,
+    bind_additive,
+    bind_multiplicative
+};
+
+typedef struct {
+    unsigned char power;        // as an infix operator, bind_none if it is not one
+    unsigned char op;
+    bool prefix;
+    unsigned char prefix_op;
+} operatorEntry;
+
+static const operatorEntry operators[eof_token + 1] = {
+    [equal_token] = {bind_assignment, assignment_op},
+    [plus_equal_token] = {bind_assignment, plus_assignment_op},
+    [minus_equal_token] = {bind_assignment, minus_assignment_op},
+    [star_equal_token] = {bind_assignment, star_assignment_op},
+    [slash_equal_token] = {bind_assignment, slash_assignment_op},
+    [percent_equal_token] = {bind_assignment, percent_assignment_op},
+    [and_equal_token] = {bind_assignment, bitwise_and_assignment_op},
+    [or_equal_token] = {bind_assignment, bitwise_or_assignment_op},
+    [xor_equal_token] = {bind_assignment, bitwise_xor_assignment_op},
+    [shift_left_equal_token] = {bind_assignment, shift_left_assignment_op},
+    [shift_right_equal_token] = {bind_assignment, shift_right_assignment_op},
+    [or_token] = {bind_or, or_op},
+    [and_token] = {bind_and, and_op},
+    [bitwise_or_token] = {bind_bitwise_or, bitwise_or_op},
+    [bitwise_xor_token] = {bind_bitwise_xor, bitwise_xor_op},
+    [address_token] = {bind_bitwise_and, bitwise_and_op, true, address_op},
+    [equal_equal_token] = {bind_equality, equal_op},
+    [not_equal_token] = {bind_equality, not_equal_op},
+    [less_token] = {bind_relational, less_op},
+    [less_equal_token] = {bind_relational, less_or_equal_op},
+    [greater_token] = {bind_relational, greater_op},
+    [greater_equal_token] = {bind_relational, greater_or_equal_op},
+    [shift_left_token] = {bind_shift, shift_left_op},
+    [shift_right_token] = {bind_shift, shift_right_op},
+    [plus_token] = {bind_additive, plus_op, true, plus_op},
+    [minus_token] = {bind_additive, minus_op, true, minus_op},
+    [star_token] = {bind_multiplicative, star_op, true, dereference_op},
+    [slash_token] = {bind_multiplicative, slash_op},
+    [percent_token] = {bind_multiplicative, percent_op},
+    [increment_token] = {bind_none, 0, true, increment_op},
+    [decrement_token] = {bind_none, 0, true, decrement_op},
+    [not_token] = {bind_none, 0, true, not_op},
+    [bitwise_not_token] = {bind_none, 0, true, bitwise_not_op},
+};
+
+static const char *tokenName(parser *parser, token *token){
+    if(token->type == identifier_token && token->data.identifier) return atomName(token->data.identifier);
+    return internName(tokenLexeme(parser->lexer, token), token->length);
+}
+
+static const char *literalName(const char *text){
+    return internName(text, strlen(text));
+}
+
+// Lists are built on the parser's scratch stack: a list remembers where it
+// started, pushes its elements and is copied out at its exact size once it
+// is complete. Nested lists share the stack, so it only grows as deep as the
+// largest set of open lists.
+static bool pushScratch(parser *parser, astNode *node){
+    if(parser->scratch_count == parser->scratch_capacity){
+        int capacity = parser->scratch_capacity ? parser->scratch_capacity * 2 : 64;
+        astNode **scratch = realloc(parser->scratch, capacity * sizeof(astNode *));
+        if(!scratch) return false;
+
+        parser->scratch = scratch;
+        parser->scratch_capacity = capacity;
+    }
+    parser->scratch[parser->scratch_count++] = node;
+    return true;
+}
+
+static void dropScratch(parser *parser, int base){
+    for(int i = base; i < parser->scratch_count; i++) freeAst(parser->scratch[i]);
+    parser->scratch_count = base;
+}
+
+static astNode *commitScratch(parser *parser, int base){
+    int count = parser->scratch_count - base;
+    astNode *body = createBodyNode(count ? &parser->scratch[base] : NULL, count);
+    if(!body){
+        dropScratch(parser, base);
+        return NULL;
+    }
+    parser->scratch_count = base;
+    return body;
+}
 
 void initParser(parser *parser, lexer *lexer){
     parser->lexer = lexer;
+    parser->tokens = NULL;
+    parser->index = 0;
+    parser->ahead_first = 0;
+    parser->ahead_count = 0;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->lazy_bodies = false;
+    parser->keep_atoms = false;
     parser->current = nextToken(lexer);
 }
 
+void initParserFromTokens(parser *parser, lexer *lexer, tokenBuffer *tokens){
+    parser->lexer = lexer;
+    parser->tokens = tokens;
+    parser->index = 0;
+    parser->ahead_first = 0;
+    parser->ahead_count = 0;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->lazy_bodies = false;
+    parser->keep_atoms = false;
+    parser->current = tokenAt(tokens, 0);
+}
+
+void freeParser(parser *parser){
+    free(parser->scratch);
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+}
+
 void advanceParser(parser *parser){
-    freeToken(&parser->current);
+    if(parser->tokens){
+        if(parser->current.type != eof_token) parser->index++;
+        parser->current = tokenAt(parser->tokens, parser->index);
+        return;
+    }
+    if(parser->ahead_count > 0){
+        parser->current = parser->ahead[parser->ahead_first];
+        parser->ahead_first = (parser->ahead_first + 1) % PARSER_LOOKAHEAD;
+        parser->ahead_count--;
+        return;
+    }
     parser->current = nextToken(parser->lexer);
 }
 
-astNode *parseAssignment(parser *parser){
-    astNode *left = parseLogicalOr(parser);
-    token_type type = parser->current.type;
-
-    if(type == equal_token || type == plus_equal_token || type == minus_equal_token || type == star_equal_token || type == slash_equal_token || type == percent_equal_token || type == and_equal_token || type == or_equal_token || type == xor_equal_token || type == shift_left_equal_token || type == shift_right_equal_token){
-        opType op;
-        switch(type){
-            case equal_token:
-                op = assignment_op;
-                break;
-            case plus_equal_token:
-                op = plus_assignment_op;
-                break;
-            case minus_equal_token:
-                op = minus_assignment_op;
-                break;
-            case star_equal_token:
-                op = star_assignment_op;
-                break;
-            case slash_equal_token:
-                op = slash_assignment_op;
-                break;
-            case percent_equal_token:
-                op = percent_assignment_op;
-                break;
-            case and_equal_token:
-                op = bitwise_and_assignment_op;
-                break;
-            case or_equal_token:
-                op = bitwise_or_assignment_op;
-                break;
-            case xor_equal_token:
-                op = bitwise_xor_assignment_op;
-                break;
-            case shift_left_equal_token:
-                op = shift_left_assignment_op;
-                break;
-            case shift_right_equal_token:
-                op = shift_right_assignment_op;
-                break;
-            default:
-                op = assignment_op;
-                break;
-        }
-        advanceParser(parser);
+token peekToken(parser *parser, int k){
+    if(k <= 0) return parser->current;
+    if(parser->tokens) return tokenAt(parser->tokens, parser->index + k);
 
-        astNode *right = parseAssignment(parser);
-        left = createAssignmentNode(left, right, op);
+    while(parser->ahead_count < k){
+        int slot = (parser->ahead_first + parser->ahead_count) % PARSER_LOOKAHEAD;
+        parser->ahead[slot] = nextToken(parser->lexer);
+        parser->ahead_count++;
     }
-    return left;
+    return parser->ahead[(parser->ahead_first + k - 1) % PARSER_LOOKAHEAD];
 }
 
 astNode *parseExpression(parser *parser){
-    return parseAssignment(parser);
+    return parseBinary(parser, bind_assignment);
 }
 
 astNode *parsePrimary(parser *parser) {
     token token = parser->current;
 
     if(token.type == self_token){
-        astNode *node = createIdentifierNode("self");
+        astNode *node = createIdentifierNode(literalName("self"));
         advanceParser(parser);
         return node;
     }
@@ -125,7 +217,7 @@ astNode *parsePrimary(parser *parser) {
             return NULL;
         }
 
-        char *name = strdup(parser->current.data.identifier);
+        const char *name = tokenName(parser, &parser->current);
         advanceParser(parser);
 
         if(parser->current.type == colon_token){
@@ -133,7 +225,6 @@ astNode *parsePrimary(parser *parser) {
 
             astNode *type = parseType(parser);
             if(!type){
-                free(name);
                 return NULL;
             }
 
@@ -143,18 +234,15 @@ astNode *parsePrimary(parser *parser) {
                 initializer = parseExpression(parser);
                 if (!initializer) {
                     freeAst(type);
-                    free(name);
                     return NULL;
                 }
             }
 
             astNode *node = createDefineNode(type, name, initializer, flags);
-            free(name); 
             return node;
         }
 
         astNode *node = createIdentifierNode(name);
-        free(name); 
         return node;
     }
 
@@ -186,26 +274,21 @@ astNode *parsePrimary(parser *parser) {
 
     if(token.type == l_bracket_token){
         advanceParser(parser);
-        astNode **elements = NULL;
-        int count = 0;
+        int base = parser->scratch_count;
 
         if(parser->current.type != r_bracket_token){
             while(1){
                 astNode *expr = parseExpression(parser);
                 if(!expr){
-                    for(int i = 0; i < count; i++) freeAst(elements[i]);
-                    free(elements);
+                    dropScratch(parser, base);
                     return NULL;
                 }
 
-                astNode **tmp = realloc(elements, sizeof(astNode *) * (count + 1));
-                if(!tmp){
-                    for(int i = 0; i < count; i++) freeAst(elements[i]);
-                    free(elements);
+                if(!pushScratch(parser, expr)){
+                    freeAst(expr);
+                    dropScratch(parser, base);
                     return NULL;
                 }
-                elements = tmp;
-                elements[count++] = expr;
 
                 if(parser->current.type == comma_token){
                     advanceParser(parser);
@@ -215,15 +298,12 @@ astNode *parsePrimary(parser *parser) {
             }
         }
         if(parser->current.type != r_bracket_token){
-            for(int i = 0; i < count; i++) freeAst(elements[i]);
-            free(elements);
+            dropScratch(parser, base);
             return NULL;
         }
         advanceParser(parser);
 
-        astNode *body = createBodyNode(elements, count);
-        free(elements);
-
+        astNode *body = commitScratch(parser, base);
         return createArrayNode(NULL, NULL, body);
     }
     return NULL;
@@ -236,28 +316,22 @@ astNode *parsePostfix(parser *parser){
         if(parser->current.type == l_paren_token){
             advanceParser(parser);
 
-            astNode **args = NULL;
-            int count = 0;
+            int base = parser->scratch_count;
 
             if(parser->current.type != r_paren_token){
                 while(1){
                     astNode *arg = parseExpression(parser);
                     if(!arg){
-                        for(int i = 0; i < count; i++) freeAst(args[i]);
-                        free(args);
+                        dropScratch(parser, base);
                         return NULL;
                     }
 
-                    astNode **tmp = realloc(args, sizeof(astNode *) * (count + 1));
-                    if(!tmp){
-                        for(int i = 0; i < count; i++) freeAst(args[i]);
-                        free(args);
+                    if(!pushScratch(parser, arg)){
+                        freeAst(arg);
+                        dropScratch(parser, base);
                         return NULL;
                     }
 
-                    args = tmp;
-                    args[count++] = arg;
-
                     if(parser->current.type == comma_token){
                         advanceParser(parser);
                     } else {
@@ -266,14 +340,12 @@ astNode *parsePostfix(parser *parser){
                 }
             }
             if(parser->current.type != r_paren_token){
-                for(int i = 0; i < count; i++) freeAst(args[i]);
-                free(args);
+                dropScratch(parser, base);
                 return NULL;
             }
             advanceParser(parser);
 
-            astNode *args_node = createBodyNode(args, count);
-            free(args);
+            astNode *args_node = commitScratch(parser, base);
             expr = createCallNode(expr, args_node);
         }
         else if(parser->current.type == l_bracket_token){
@@ -303,7 +375,7 @@ astNode *parsePostfix(parser *parser){
                 return NULL;
             }
 
-            char *member = strdup(parser->current.data.identifier);
+            const char *member = tokenName(parser, &parser->current);
             advanceParser(parser);
 
             if (op_type == arrow_token) {
@@ -311,7 +383,6 @@ astNode *parsePostfix(parser *parser){
             } else {
                 expr = createDotAccessNode(expr, member);
             }
-            free(member);
         }
         else {
             token op = parser->current;
@@ -333,19 +404,11 @@ astNode *parsePostfix(parser *parser){
     return expr;
 }
 
-static token_type peekNextTokenType(parser *parser){
-    lexer temp_lexer = *parser->lexer;
-    token next = nextToken(&temp_lexer);
-    token_type type = next.type;
-    freeToken(&next);
-    return type;
-}
-
 astNode *parseUnary(parser *parser){
     token_type current_type = parser->current.type;
 
     if(current_type == l_paren_token){
-        token_type next_type = peekNextTokenType(parser);
+        token_type next_type = peekToken(parser, 1).type;
 
         if(isTypeToken(next_type)){
             advanceParser(parser);
@@ -359,250 +422,61 @@ astNode *parseUnary(parser *parser){
             return createCastNode(type, operand);
         }
     }
-    if(current_type == not_token || current_type == minus_token || current_type == decrement_token || current_type == plus_token || current_type == increment_token || current_type == star_token || current_type == address_token || current_type == sizeof_token || current_type == bitwise_not_token){
-        token op = parser->current;
+    if(current_type == sizeof_token){
         advanceParser(parser);
 
-        if(op.type == sizeof_token){
-            astNode *operand = NULL;
-            if(parser->current.type == l_paren_token){
-                advanceParser(parser);
-                if(isTypeToken(parser->current.type)){
-                    operand = parseType(parser);
-                } else {
-                    operand = parseExpression(parser);
-                }
-                if (parser->current.type == r_paren_token) {
-                    advanceParser(parser);
-                }
+        astNode *operand = NULL;
+        if(parser->current.type == l_paren_token){
+            advanceParser(parser);
+            if(isTypeToken(parser->current.type)){
+                operand = parseType(parser);
             } else {
-                operand = parseUnary(parser);
+                operand = parseExpression(parser);
+            }
+            if (parser->current.type == r_paren_token) {
+                advanceParser(parser);
             }
-            return createSizeofNode(operand);
+        } else {
+            operand = parseUnary(parser);
         }
+        return createSizeofNode(operand);
+    }
 
-        astNode *right = parseUnary(parser);
-        opType operation;
-
-        switch(op.type){
-            case not_token: 
-                operation = not_op;
-                break;
-            case minus_token:
-                operation = minus_op;
-                break;
-            case decrement_token:
-                operation = decrement_op;
-                break;
-            case plus_token:
-                operation = plus_op;
-                break;
-            case increment_token:
-                operation = increment_op;
-                break;
-            case star_token:
-                operation = dereference_op;
-                break;
-            case address_token:
-                operation = address_op;
-                break;
-            case bitwise_not_token:
-                operation = bitwise_not_op;
-                break;
-            default:
-                return parsePostfix(parser);
-        }
+    const operatorEntry *entry = &operators[current_type];
+    if(entry->prefix){
+        advanceParser(parser);
 
-        return createDataOperationNode(NULL, right, operation);
+        astNode *right = parseUnary(parser);
+        if(!right) return NULL;
+        return createDataOperationNode(NULL, right, entry->prefix_op);
     }
     return parsePostfix(parser);
 }
 
-astNode *parseMultiplicative(parser *parser){
+// Parses operators that bind at least as tightly as min_power. Each operand
+// is one parseUnary call, however deep the precedence of what follows it.
+astNode *parseBinary(parser *parser, int min_power){
     astNode *left = parseUnary(parser);
+    if(!left) return NULL;
 
-    while(parser->current.type == star_token || parser->current.type == slash_token || parser->current.type == percent_token){
-        token op = parser->current;
+    while(1){
+        const operatorEntry *entry = &operators[parser->current.type];
+        if(entry->power == bind_none || entry->power < min_power) break;
         advanceParser(parser);
 
-        astNode *right = parseUnary(parser);
+        // Assignment is right-associative, everything else groups left.
+        int right_power = entry->power == bind_assignment ? entry->power : entry->power + 1;
+        astNode *right = parseBinary(parser, right_power);
         if(!right){
             freeAst(left);
             return NULL;
         }
 
-        opType operation;
-        switch(op.type){
-            case star_token:
-                operation = star_op;
-                break;
-            case slash_token:
-                operation = slash_op;
-                break;
-            case percent_token:
-                operation = percent_op;
-                break;
-            default:
-                return left;
-        }
-        left = createDataOperationNode(left, right, operation);
-    }
-    return left;
-}
-
-astNode *parseAdditive(parser *parser){
-    astNode *left = parseMultiplicative(parser);
-    if(!left) return NULL;
-
-    while(parser->current.type == plus_token || parser->current.type == minus_token){
-        token op = parser->current;
-        advanceParser(parser);
-
-        astNode *right = parseMultiplicative(parser);
-
-        opType operation;
-        switch(op.type){
-            case plus_token:
-                operation = plus_op;
-                break;
-            case minus_token:
-                operation = minus_op;
-                break;
-            default:
-                return left;
-        }
-        left = createDataOperationNode(left, right, operation);
-    }
-    return left;
-}
-
-astNode *parseRelational(parser *parser){
-    astNode *left = parseShift(parser);
-
-    while(parser->current.type == less_token || parser->current.type == less_equal_token || parser->current.type == greater_token || parser->current.type == greater_equal_token){
-        token op = parser->current;
-        advanceParser(parser);
-
-        astNode *right = parseShift(parser);
-
-        opType operation;
-        switch(op.type){
-            case less_token:
-                operation = less_op;
-                break;
-            case less_equal_token:
-                operation = less_or_equal_op;
-                break;
-            case greater_token:
-                operation = greater_op;
-                break;
-            case greater_equal_token:
-                operation = greater_or_equal_op;
-                break;
-            default:
-                return left;
-        }
-        left = createDataOperationNode(left, right, operation);
-    }
-    return left;
-}
-
-astNode *parseEquality(parser *parser){
-    astNode *left = parseRelational(parser);
-
-    while(parser->current.type == equal_equal_token || parser->current.type == not_equal_token){
-        token op = parser->current;
-        advanceParser(parser);
-
-        astNode *right = parseRelational(parser);
-
-        opType operation;
-        switch(op.type){
-            case equal_equal_token:
-                operation = equal_op;
-                break;
-            case not_equal_token:
-                operation = not_equal_op;
-                break;
-            default:
-                return left;
+        if(entry->power == bind_assignment){
+            left = createAssignmentNode(left, right, entry->op);
+        } else {
+            left = createDataOperationNode(left, right, entry->op);
         }
-        left = createDataOperationNode(left, right, operation);
-    }
-    return left;
-}
-
-astNode *parseLogicalAnd(parser *parser){
-    astNode *left = parseBitwiseOr(parser);
-
-    while(parser->current.type == and_token){
-        advanceParser(parser);
-
-        astNode *right = parseBitwiseOr(parser);
-        left = createDataOperationNode(left, right, and_op);
-    }
-    return left;
-}
-
-astNode *parseLogicalOr(parser *parser){
-    astNode *left = parseLogicalAnd(parser);
-
-    while(parser->current.type == or_token){
-        advanceParser(parser);
-
-        astNode *right = parseLogicalAnd(parser);
-        left = createDataOperationNode(left, right, or_op);
-    }
-    return left;
-}
-
-astNode *parseShift(parser *parser){
-    astNode *left = parseAdditive(parser);
-
-    while(parser->current.type == shift_left_token || parser->current.type == shift_right_token){
-        token op = parser->current;
-        advanceParser(parser);
-
-        astNode *right = parseAdditive(parser);
-        opType operation = (op.type == shift_left_token) ? shift_left_op : shift_right_op;
-        
-        left = createDataOperationNode(left, right, operation);
-    }
-    return left;
-}
-
-astNode *parseBitwiseAnd(parser *parser){
-    astNode *left = parseEquality(parser);
-
-    while(parser->current.type == address_token){
-        advanceParser(parser);
-
-        astNode *right = parseEquality(parser);
-        left = createDataOperationNode(left, right, bitwise_and_op);
-    }
-    return left;
-}
-
-astNode *parseBitwiseXor(parser *parser){
-    astNode *left = parseBitwiseAnd(parser);
-
-    while(parser->current.type == bitwise_xor_token){
-        advanceParser(parser);
-
-        astNode *right = parseBitwiseAnd(parser);
-        left = createDataOperationNode(left, right, bitwise_xor_op);
-    }
-    return left;
-}
-
-astNode *parseBitwiseOr(parser *parser){
-    astNode *left = parseBitwiseXor(parser);
-
-    while(parser->current.type == bitwise_or_token){
-        advanceParser(parser);
-
-        astNode *right = parseBitwiseXor(parser);
-        left = createDataOperationNode(left, right, bitwise_or_op);
     }
     return left;
 }
@@ -638,40 +512,30 @@ astNode *parseBody(parser *parser){
     if(parser->current.type != l_brace_token) return NULL;
     advanceParser(parser);
 
-    astNode **elements = NULL;
-    int count = 0;
+    int base = parser->scratch_count;
 
     while(parser->current.type != r_brace_token && parser->current.type != eof_token){
         astNode *stmt = parseStatement(parser);
 
         if(!stmt){
-            for(int i = 0; i < count; i++) freeAst(elements[i]);
-            free(elements);
+            dropScratch(parser, base);
             return NULL;
         }
 
-        astNode **tmp = realloc(elements, sizeof(astNode *) * (count + 1));
-        
-        if(!tmp){
-            for(int i = 0; i < count; i++) freeAst(elements[i]);
-            free(elements);
+        if(!pushScratch(parser, stmt)){
+            freeAst(stmt);
+            dropScratch(parser, base);
             return NULL;
         }
-
-        elements = tmp;
-        elements[count++] = stmt;
     }
 
     if(parser->current.type != r_brace_token){
-        for(int i = 0; i < count; i++) freeAst(elements[i]);
-        free(elements);
+        dropScratch(parser, base);
         return NULL;
     }
 
     advanceParser(parser);
-    astNode *body = createBodyNode(elements, count);
-    free(elements);
-    return body;
+    return commitScratch(parser, base);
 }
 
 astNode *parseIfExpression(parser *parser) {
@@ -946,7 +810,7 @@ astNode *parseImportStatement(parser *parser){
 
     if(parser->current.type != string_literal_token) return NULL;
     
-    char *import_name = parser->current.data.properties.value.value.str_value;
+    const char *import_name = literalName(parser->current.data.properties.value.value.str_value);
     astNode *name_node = createIdentifierNode(import_name);
     
     advanceParser(parser);
@@ -956,6 +820,45 @@ astNode *parseImportStatement(parser *parser){
     return createImportNode(name_node); 
 }
 
+// Steps over the body at current and returns a lazy_body node for it, or
+// NULL to have it parsed right away.
+static astNode *skipBody(parser *parser){
+    long long start = parser->current.start;
+
+    if(parser->tokens){
+        tokenBuffer *tokens = parser->tokens;
+        int index = parser->index;
+        int depth = 0;
+        for(; index < tokens->count; index++){
+            if(tokens->kind[index] == l_brace_token) depth++;
+            else if(tokens->kind[index] == r_brace_token && --depth == 0) break;
+        }
+        if(index == tokens->count) return NULL;
+
+        astNode *body = createLazyBodyNode(parser->lexer->src, start, tokens->offset[index] + tokens->length[index]);
+        if(!body) return NULL;
+        parser->index = index;
+        advanceParser(parser);
+        return body;
+    }
+
+    lexer *lexer = parser->lexer;
+    if(lexer->source == source_stream) return NULL;
+
+    long long end = matchBrace(lexer->src, start + 1, lexer->length);
+    if(end < 0) return NULL;
+
+    astNode *body = createLazyBodyNode(lexer->src, start, end);
+    if(!body) return NULL;
+
+    // Tokens already read ahead lie inside the body.
+    lexer->position = end;
+    parser->ahead_first = 0;
+    parser->ahead_count = 0;
+    advanceParser(parser);
+    return body;
+}
+
 astNode *parseFunction(parser *parser){
     if(parser->current.type != function_token) return NULL;
     advanceParser(parser);
@@ -963,7 +866,7 @@ astNode *parseFunction(parser *parser){
     dataFlags flags = parseFlags(parser);
 
     if(parser->current.type != identifier_token) return NULL;
-    char *func_name = strdup(parser->current.data.identifier);
+    const char *func_name = tokenName(parser, &parser->current);
     advanceParser(parser);
 
     if(parser->current.type != l_paren_token) return NULL;
@@ -973,7 +876,6 @@ astNode *parseFunction(parser *parser){
     astNode *params = parseParamList(parser, &is_variadic);
 
     if(parser->current.type != r_paren_token){
-        free(func_name);
         if(params) freeAst(params);
         return NULL;
     }
@@ -985,19 +887,19 @@ astNode *parseFunction(parser *parser){
         advanceParser(parser);
         return_type = parseType(parser);
     } else {
-        return_type = createIdentifierNode("void");
+        return_type = createIdentifierNode(literalName("void"));
     }
 
     astNode *body = NULL;
 
     if(parser->current.type == l_brace_token){
-        body = parseBody(parser);
+        body = parser->lazy_bodies ? skipBody(parser) : NULL;
+        if(!body) body = parseBody(parser);
     } else if(parser->current.type == semicolon_token){
         advanceParser(parser);
     }
 
     astNode *node = createFunctionNode(func_name, return_type, params, body, flags, is_variadic);
-    free(func_name);
     return node;
 }
 
@@ -1006,8 +908,7 @@ astNode *parseParamList(parser *parser, int *is_variadic){
         return createBodyNode(NULL, 0);
     }
 
-    astNode **params = NULL;
-    int count = 0;
+    int base = parser->scratch_count;
 
     while(parser->current.type != r_paren_token && parser->current.type != eof_token){
         astNode *param_node = NULL;
@@ -1018,26 +919,22 @@ astNode *parseParamList(parser *parser, int *is_variadic){
             break;
         }
         if(parser->current.type == self_token){
-            char *param_name = strdup("self");
+            const char *param_name = literalName("self");
             advanceParser(parser);
 
-            astNode *param_type = createIdentifierNode("self");
+            astNode *param_type = createIdentifierNode(literalName("self"));
             param_node = createDefineNode(param_type, param_name, NULL, 0);
-            free(param_name);
         } else {
             if(parser->current.type != identifier_token) {
-                for(int i = 0; i < count; i++) freeAst(params[i]);
-                free(params);
+                dropScratch(parser, base);
                 return NULL;
             }
 
-            char *param_name = strdup(parser->current.data.identifier);
+            const char *param_name = tokenName(parser, &parser->current);
             advanceParser(parser);
 
             if(parser->current.type != colon_token) {
-                free(param_name);
-                for(int i = 0; i < count; i++) freeAst(params[i]);
-                free(params);
+                dropScratch(parser, base);
                 return NULL;
             }
             advanceParser(parser);
@@ -1045,27 +942,18 @@ astNode *parseParamList(parser *parser, int *is_variadic){
             astNode *param_type = parseType(parser);
             
             if(!param_type) {
-                free(param_name);
-                for(int i = 0; i < count; i++) freeAst(params[i]);
-                free(params);
+                dropScratch(parser, base);
                 return NULL;
             }
 
             param_node = createDefineNode(param_type, param_name, NULL, 0);
-            free(param_name);
         }
 
-        astNode **tmp = realloc(params, sizeof(astNode *) * (count + 1));
-        
-        if(!tmp) {
+        if(!pushScratch(parser, param_node)) {
             freeAst(param_node); 
-            for(int i = 0; i < count; i++) freeAst(params[i]);
-            free(params);
+            dropScratch(parser, base);
             return NULL;
         }
-        
-        params = tmp;
-        params[count++] = param_node;
 
         if(parser->current.type == comma_token){
             advanceParser(parser);
@@ -1074,10 +962,7 @@ astNode *parseParamList(parser *parser, int *is_variadic){
         }
     }
     
-    astNode *body = createBodyNode(params, count);
-    free(params);
-    
-    return body;
+    return commitScratch(parser, base);
 }
 
 astNode *parseType(parser *parser){
@@ -1117,7 +1002,8 @@ astNode *parseType(parser *parser){
     }
 
     else if(t.type == void_token || t.type == short_token || t.type == int_token || t.type == float_token || t.type == double_token || t.type == string_token || t.type == bool_token || t.type == ushort_token || t.type == uint_token || t.type == ulong_token || t.type == ullong_token || t.type == identifier_token){
-        type_node = createIdentifierNode(t.lexeme);
+        const char *name = tokenName(parser, &t);
+        type_node = createIdentifierNode(name);
         advanceParser(parser);
     }
 
@@ -1125,15 +1011,15 @@ astNode *parseType(parser *parser){
         advanceParser(parser);
         
         if (parser->current.type == long_token) {
-            type_node = createIdentifierNode("long long");
+            type_node = createIdentifierNode(literalName("long long"));
             advanceParser(parser);
         } 
         else if (parser->current.type == double_token) {
-            type_node = createIdentifierNode("long double");
+            type_node = createIdentifierNode(literalName("long double"));
             advanceParser(parser);
         } 
         else {
-            type_node = createIdentifierNode("long");
+            type_node = createIdentifierNode(literalName("long"));
         }
     }
 
@@ -1166,21 +1052,19 @@ astNode *parseType(parser *parser){
 astNode *parseStruct(parser *parser){
     advanceParser(parser);
 
-    char *name = NULL;
+    const char *name = NULL;
     if(parser->current.type == identifier_token){
-        name = strdup(parser->current.data.identifier);
+        name = tokenName(parser, &parser->current);
         advanceParser(parser);
     }
 
     if(parser->current.type != l_brace_token){
         astNode *node = createStructNode(name, NULL);
-        if(name) free(name);
         return node;
     }
 
     astNode *body = parseBody(parser);
     astNode *node = createStructNode(name, body);
-    if(name) free(name);
     return node;
 }
 
@@ -1189,21 +1073,20 @@ astNode *parseImplStatement(parser *parser){
 
     if(parser->current.type != identifier_token) return NULL;
 
-    char *first_id = strdup(parser->current.data.identifier);
+    const char *first_id = tokenName(parser, &parser->current);
     advanceParser(parser);
 
-    char *trait_name = NULL;
-    char *target = NULL;
+    const char *trait_name = NULL;
+    const char *target = NULL;
 
     if(parser->current.type == for_token){
         trait_name = first_id;
         advanceParser(parser);
 
         if(parser->current.type != identifier_token){
-            free(trait_name);
             return NULL;
         }
-        target = strdup(parser->current.data.identifier);
+        target = tokenName(parser, &parser->current);
         advanceParser(parser);
     } else {
         target = first_id;
@@ -1212,15 +1095,11 @@ astNode *parseImplStatement(parser *parser){
     astNode *body = parseBody(parser);
 
     if(!body){
-        if(trait_name) free(trait_name);
-        if(target) free(target);
         return NULL;
     }
 
     astNode *node = createImplNode(trait_name, target, body);
     
-    if(trait_name) free(trait_name);
-    if(target) free(target);
 
     return node;
 }
@@ -1228,69 +1107,63 @@ astNode *parseImplStatement(parser *parser){
 astNode *parseTraitStatement(parser *parser){
     advanceParser(parser);
 
-    char *name = NULL;
+    const char *name = NULL;
     if(parser->current.type == identifier_token){
-        name = strdup(parser->current.data.identifier);
+        name = tokenName(parser, &parser->current);
         advanceParser(parser);
     }
 
     if(parser->current.type != l_brace_token){
         astNode *node = createTraitNode(name, NULL);
-        if(name) free(name);
         return node;
     }
 
     astNode *body = parseBody(parser);
     astNode *node = createTraitNode(name, body);
     
-    if(name) free(name);
     return node;
 }
 
 astNode *parseUnion(parser *parser){
     advanceParser(parser);
 
-    char *name = NULL;
+    const char *name = NULL;
     if(parser->current.type == identifier_token){
-        name = strdup(parser->current.data.identifier);
+        name = tokenName(parser, &parser->current);
         advanceParser(parser);
     }
 
     if(parser->current.type != l_brace_token){
         astNode *node = createUnionNode(name, NULL);
-        if(name) free(name);
         return node;
     }
 
     astNode *body = parseBody(parser);
     astNode *node = createUnionNode(name, body);
-    if(name) free(name);
     return node;
 }
 
 astNode *parseEnum(parser *parser){
     advanceParser(parser);
 
-    char *name = NULL;
+    const char *name = NULL;
     if(parser->current.type == identifier_token){
-        name = strdup(parser->current.data.identifier);
+        name = tokenName(parser, &parser->current);
         advanceParser(parser);
     }
 
     if(parser->current.type != l_brace_token) { 
         astNode *node = createEnumNode(name, NULL);
-        if(name) free(name);
         return node; 
     }
     advanceParser(parser);
 
-    astNode **elements = NULL;
-    int count = 0;
+    int base = parser->scratch_count;
 
     while(parser->current.type != r_brace_token && parser->current.type != eof_token){
         if(parser->current.type != identifier_token) break;
         
-        char *enum_id = strdup(parser->current.data.identifier);
+        const char *enum_id = tokenName(parser, &parser->current);
         advanceParser(parser);
 
         astNode *initializer = NULL;
@@ -1299,22 +1172,15 @@ astNode *parseEnum(parser *parser){
             initializer = parseExpression(parser);
         }
 
-        astNode *type_node = createIdentifierNode("int");
+        astNode *type_node = createIdentifierNode(literalName("int"));
         astNode *member_node = createDefineNode(type_node, enum_id, initializer, const_flag);
-        free(enum_id);
 
-        astNode **tmp = realloc(elements, sizeof(astNode *) * (count + 1));
-        if(!tmp){ 
-            for(int i = 0; i < count; i++) freeAst(elements[i]);
-            free(elements);
-            if(name) free(name);
+        if(!pushScratch(parser, member_node)){ 
+            dropScratch(parser, base);
             freeAst(member_node);
             return NULL; 
         }
 
-        elements = tmp;
-        elements[count++] = member_node;
-
         if(parser->current.type == comma_token){
             advanceParser(parser);
         } else {
@@ -1323,18 +1189,13 @@ astNode *parseEnum(parser *parser){
     }
 
     if(parser->current.type != r_brace_token){
-        for(int i = 0; i < count; i++) freeAst(elements[i]);
-        free(elements);
-        if(name) free(name);
+        dropScratch(parser, base);
         return NULL;
     }
     advanceParser(parser);
 
-    astNode *body = createBodyNode(elements, count);
+    astNode *body = commitScratch(parser, base);
     astNode *node = createEnumNode(name, body);
-
-    free(elements);
-    if(name) free(name);
     return node;
 }
 
@@ -1349,7 +1210,7 @@ astNode *parseTypedef(parser *parser) {
         return NULL;
     }
 
-    char *alias_name = strdup(parser->current.data.identifier);
+    const char *alias_name = tokenName(parser, &parser->current);
     advanceParser(parser);
 
     if(parser->current.type == semicolon_token){
@@ -1357,7 +1218,6 @@ astNode *parseTypedef(parser *parser) {
     }
 
     astNode *node = createTypedefNode(target_type, alias_name);
-    free(alias_name);
     
     return node;
 }
@@ -1443,4 +1303,429 @@ astNode *parseStatement(parser *parser){
             return expr;
         }
     }
-}
\ No newline at end of file
+}
+
+// The tokens read past a statement were lexed while it was parsed, so their
+// names and literals are copied out, released with the rest and interned
+// again. Returns false, releasing nothing, if memory ran out.
+static bool releaseStatementAtoms(parser *parser, atomMark mark){
+    token *pending[PARSER_LOOKAHEAD + 1];
+    char *saved[PARSER_LOOKAHEAD + 1];
+    size_t lengths[PARSER_LOOKAHEAD + 1];
+    int count = 0;
+
+    pending[count++] = &parser->current;
+    for(int i = 0; i < parser->ahead_count; i++){
+        pending[count++] = &parser->ahead[(parser->ahead_first + i) % PARSER_LOOKAHEAD];
+    }
+
+    bool ok = true;
+    for(int i = 0; i < count; i++){
+        token *token = pending[i];
+        const char *text = NULL;
+        if(token->type == identifier_token) text = atomName(token->data.identifier);
+        else if(token->type == string_literal_token) text = token->data.properties.value.value.str_value;
+
+        saved[i] = NULL;
+        if(!text) continue;
+        lengths[i] = nameLength(text);
+        saved[i] = malloc(lengths[i] + 1);
+        if(!saved[i]){
+            ok = false;
+            continue;
+        }
+        memcpy(saved[i], text, lengths[i]);
+    }
+
+    if(ok) releaseAtoms(mark);
+    for(int i = 0; i < count; i++){
+        if(!saved[i]) continue;
+        if(ok){
+            token *token = pending[i];
+            if(token->type == identifier_token) token->data.identifier = internAtom(saved[i], lengths[i]);
+            else token->data.properties.value.value.str_value = internLiteral(saved[i], lengths[i]);
+        }
+        free(saved[i]);
+    }
+    return ok;
+}
+
+// Releasing after every statement would make inputs that repeat the same
+// few names intern them over and over, so atoms are allowed to pile up to this
+// many first.
+#define STREAM_ATOM_LIMIT 4096
+
+bool parseProgramStreaming(parser *parser, statementCallback callback, void *ctx){
+    astArena arena;
+    initArena(&arena);
+    astArena *previous = useArena(&arena);
+    atomMark mark = markAtoms();
+
+    bool complete = false;
+    while(1){
+        astNode *statement = parseStatement(parser);
+        if(!statement){
+            complete = parser->current.type == eof_token;
+            break;
+        }
+
+        bool more = callback(statement, ctx);
+        resetArena(&arena);
+        if(!parser->keep_atoms && atomsSince(mark) > STREAM_ATOM_LIMIT) releaseStatementAtoms(parser, mark);
+        if(!more) break;
+    }
+
+    useArena(previous);
+    freeArena(&arena);
+    return complete;
+}
+
+// Byte-level scanning for lazy bodies and parallel parsing. Strings and
+// comments are skipped exactly as the lexer skips them, so every position
+// these scanners stop at is a token boundary.
+//
+// Parallel parsing splits the input right after a '}' or ';' that is outside
+// every bracket and followed by a declaration keyword. Such a split is a
+// token boundary, and no statement continues into a declaration keyword, so
+// it is a statement boundary too. Ranges are then parsed independently. A range
+// that stops early is parsed again in place, from its start to the end of the
+// input, which is what the serial loop would have seen; later ranges are
+// dropped. That keeps even broken input identical to the serial result.
+#define PARSE_MIN_RANGE (1 << 16)
+
+static const char *declarationKeywords[] = {"fun", "struct", "enum", "union", "impl", "trait"};
+
+static bool isIdentByte(char c){
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static long long skipBlockComment(const char *src, long long position, long long length){
+    while(position < length){
+        const char *star = memchr(&src[position], '*', length - position);
+        if(!star) return length;
+
+        position = star - src + 1;
+        if(src[position] == '/') return position + 1;
+    }
+    return length;
+}
+
+static long long skipLineComment(const char *src, long long position, long long length){
+    const char *newline = memchr(&src[position], '\n', length - position);
+    return newline ? newline - src : length;
+}
+
+// Returns the position after the closing delimiter, or -1 if the string
+// runs to the end of the input.
+static long long skipString(const char *src, long long position, long long length, char delimiter){
+    while(1){
+        while(position < length && src[position] != delimiter && src[position] != '\\' && src[position] != '\0') position++;
+        if(position + 1 < length && src[position] == '\\'){
+            position += 2;
+            continue;
+        }
+        break;
+    }
+    if(position >= length || src[position] != delimiter) return -1;
+    return position + 1;
+}
+
+static bool declarationAt(const char *src, long long position, long long length){
+    while(position < length){
+        char c = src[position];
+        if(c == ' ' || (c >= '\t' && c <= '\r')){
+            position++;
+        } else if(c == '/' && src[position + 1] == '/'){
+            position = skipLineComment(src, position, length);
+        } else if(c == '/' && src[position + 1] == '*'){
+            position = skipBlockComment(src, position + 2, length);
+        } else {
+            break;
+        }
+    }
+
+    for(size_t i = 0; i < sizeof(declarationKeywords) / sizeof(declarationKeywords[0]); i++){
+        size_t keyword_length = strlen(declarationKeywords[i]);
+        if(length - position < (long long)keyword_length) continue;
+        if(memcmp(&src[position], declarationKeywords[i], keyword_length) == 0 && !isIdentByte(src[position + keyword_length])) return true;
+    }
+    return false;
+}
+
+// Returns the first split at or after target, or length if there is none.
+// position must be a split or the start of the input.
+static long long nextSplit(const char *src, long long position, long long length, long long target){
+    int depth = 0;
+    while(position < length){
+        char c = src[position++];
+        switch(c){
+            case '\0':
+                return length;
+            case '"':
+            case '\'':
+                position = skipString(src, position, length, c);
+                if(position < 0) return length;
+                break;
+            case '/':
+                if(src[position] == '/'){
+                    position = skipLineComment(src, position, length);
+                } else if(src[position] == '*'){
+                    position = skipBlockComment(src, position + 1, length);
+                }
+                break;
+            case '{':
+            case '(':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ')':
+            case ']':
+                depth--;
+                if(c == '}' && depth == 0 && position >= target && declarationAt(src, position, length)) return position;
+                break;
+            case ';':
+                if(depth == 0 && position >= target && declarationAt(src, position, length)) return position;
+                break;
+            default:
+                break;
+        }
+    }
+    return length;
+}
+
+// position is just after a '{'. Returns the position after its matching
+// '}', or -1 if the input ends first.
+static long long matchBrace(const char *src, long long position, long long length){
+    int depth = 1;
+    while(position < length){
+        char c = src[position++];
+        switch(c){
+            case '\0':
+                return -1;
+            case '"':
+            case '\'':
+                position = skipString(src, position, length, c);
+                if(position < 0) return -1;
+                break;
+            case '/':
+                if(src[position] == '/'){
+                    position = skipLineComment(src, position, length);
+                } else if(src[position] == '*'){
+                    position = skipBlockComment(src, position + 1, length);
+                }
+                break;
+            case '{':
+                depth++;
+                break;
+            case '}':
+                if(--depth == 0) return position;
+                break;
+            default:
+                break;
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    const char *src;
+    long long start;
+    long long end;
+    bool last;
+    astArena *arena;
+    astNode *statements;
+    bool ok;
+    bool complete;
+    // Where the range's lexer stopped, as an offset into src.
+    long long position;
+} parseRange;
+
+static void parseRangeWith(parseRange *range, lexer *lexer){
+    astArena *previous = useArena(range->arena);
+    parser parser;
+    initParser(&parser, lexer);
+    range->ok = true;
+
+    while(1){
+        astNode *node = parseStatement(&parser);
+        if(!node) break;
+        if(!pushScratch(&parser, node)){
+            range->ok = false;
+            break;
+        }
+    }
+    range->complete = parser.current.type == eof_token;
+    range->position = lexer->position;
+    range->statements = commitScratch(&parser, 0);
+    if(!range->statements) range->ok = false;
+
+    freeParser(&parser);
+    useArena(previous);
+}
+
+// The lexer needs a '\0' right after its input, so every range but the last
+// is parsed from a copy.
+static void *parseRangeWorker(void *arg){
+    parseRange *range = arg;
+    long long length = range->end - range->start;
+    const char *src = &range->src[range->start];
+    char *copy = NULL;
+
+    if(!range->last){
+        copy = malloc(length + 1);
+        if(!copy){
+            range->ok = false;
+            return NULL;
+        }
+        memcpy(copy, src, length);
+        copy[length] = '\0';
+        src = copy;
+    }
+
+    lexer lexer;
+    initLexerBorrowed(&lexer, src, length);
+    parseRangeWith(range, &lexer);
+    range->position += range->start;
+    freeLexer(&lexer);
+    free(copy);
+    return NULL;
+}
+
+bool parseProgramParallel(lexer *lexer, parsedProgram *program, int threads){
+    memset(program, 0, sizeof(parsedProgram));
+
+    long long start = lexer->position;
+    long long length = lexer->length;
+    int count = threads;
+    if(threads <= 1 || lexer->source == source_stream || length - start < (long long)threads * PARSE_MIN_RANGE) count = 1;
+
+    parseRange *ranges = calloc(count, sizeof(parseRange));
+    pthread_t *workers = calloc(count, sizeof(pthread_t));
+    program->arenas = calloc(count, sizeof(astArena));
+    if(!ranges || !workers || !program->arenas){
+        free(ranges);
+        free(workers);
+        freeParsedProgram(program);
+        return false;
+    }
+    for(int i = 0; i < count; i++) initArena(&program->arenas[i]);
+    program->arena_count = count;
+
+    int used = 1;
+    ranges[0].start = start;
+    if(count > 1){
+        long long step = (length - start) / count;
+        for(; used < count; used++){
+            long long split = nextSplit(lexer->src, ranges[used - 1].start, length, start + step * used);
+            if(split >= length) break;
+            ranges[used - 1].end = split;
+            ranges[used].start = split;
+        }
+    }
+    ranges[used - 1].end = length;
+    ranges[used - 1].last = true;
+    for(int i = 0; i < used; i++){
+        ranges[i].src = lexer->src;
+        ranges[i].arena = &program->arenas[i];
+    }
+
+    if(used == 1){
+        parseRangeWith(&ranges[0], lexer);
+    } else {
+        int started = 0;
+        for(; started < used; started++){
+            if(pthread_create(&workers[started], NULL, parseRangeWorker, &ranges[started]) != 0) break;
+        }
+        for(int i = started; i < used; i++) parseRangeWorker(&ranges[i]);
+        for(int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    }
+
+    bool ok = true;
+    int kept = used;
+    for(int i = 0; i < used && ok; i++){
+        ok = ranges[i].ok;
+        if(!ok || ranges[i].complete) continue;
+
+        if(!ranges[i].last){
+            resetArena(ranges[i].arena);
+            ranges[i].end = length;
+            ranges[i].last = true;
+            parseRangeWorker(&ranges[i]);
+            ok = ranges[i].ok;
+        }
+        kept = i + 1;
+        break;
+    }
+
+    int total = 0;
+    for(int i = 0; i < kept && ok; i++) total += ranges[i].statements->body.elements_count;
+
+    astNode **elements = NULL;
+    if(ok && total > 0){
+        elements = malloc(total * sizeof(astNode *));
+        ok = elements != NULL;
+    }
+    if(ok){
+        int at = 0;
+        for(int i = 0; i < kept; i++){
+            astNode *statements = ranges[i].statements;
+            if(statements->body.elements_count == 0) continue;
+
+            memcpy(&elements[at], statements->body.elements, statements->body.elements_count * sizeof(astNode *));
+            at += statements->body.elements_count;
+        }
+
+        astArena *previous = useArena(&program->arenas[0]);
+        program->body = createBodyNode(elements, total);
+        useArena(previous);
+        program->complete = ranges[kept - 1].complete;
+        ok = program->body != NULL;
+    }
+    long long position = ranges[kept - 1].position;
+    free(elements);
+    free(ranges);
+    free(workers);
+
+    if(!ok){
+        freeParsedProgram(program);
+        return false;
+    }
+    for(int i = kept; i < program->arena_count; i++) freeArena(&program->arenas[i]);
+    program->arena_count = kept;
+    // As after a serial parse, the lexer is left where parsing stopped.
+    lexer->position = position;
+    return true;
+}
+
+void freeParsedProgram(parsedProgram *program){
+    for(int i = 0; i < program->arena_count; i++) freeArena(&program->arenas[i]);
+    free(program->arenas);
+    memset(program, 0, sizeof(parsedProgram));
+}
+
+astNode *functionBody(astNode *function){
+    astNode *body = function->function.body;
+    if(!body || body->type != lazy_body_node) return body;
+
+    // Like a parallel range, the body needs a '\0' right after it.
+    long long length = body->lazy_body.end - body->lazy_body.start;
+    char *copy = malloc(length + 1);
+    if(!copy) return NULL;
+    memcpy(copy, &body->lazy_body.src[body->lazy_body.start], length);
+    copy[length] = '\0';
+
+    lexer lexer;
+    initLexerBorrowed(&lexer, copy, length);
+    parser parser;
+    initParser(&parser, &lexer);
+    astNode *parsed = parseBody(&parser);
+    freeParser(&parser);
+    freeLexer(&lexer);
+    free(copy);
+    if(!parsed) return NULL;
+
+    function->function.body = parsed;
+    freeAst(body);
+    return parsed;
+}
@@ -5,14 +5,88 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define PARSER_LOOKAHEAD 4
+// Bumped whenever the lexer or parser builds a different tree for some
+// input. Trees cached (astcache.h) under another revision are parsed again.
+#define PARSER_REVISION 2
+
 typedef struct {
     lexer *lexer;
     token current;
+    tokenBuffer *tokens;
+    int index;
+
+    // Tokens already taken from the lexer beyond current, oldest first.
+    token ahead[PARSER_LOOKAHEAD];
+    int ahead_first;
+    int ahead_count;
+
+    // Elements of the lists being parsed, innermost list on top.
+    astNode **scratch;
+    int scratch_count;
+    int scratch_capacity;
+
+    // Off by default. When set, parseFunction skips over function bodies by
+    // brace matching and leaves a lazy_body node for functionBody to parse.
+    // Stream lexers always parse bodies.
+    bool lazy_bodies;
+
+    // Off by default, so parseProgramStreaming releases the names and
+    // literals statements added to the atom tables after their callbacks
+    // return. Set it if callbacks keep atoms, names or string values.
+    bool keep_atoms;
 } parser;
 
 void initParser(parser *parser, lexer *lexer);
+// Walks a buffer filled by lexAll instead of pulling tokens from the lexer,
+// which is still needed for lexeme text.
+void initParserFromTokens(parser *parser, lexer *lexer, tokenBuffer *tokens);
+void freeParser(parser *parser);
 void advanceParser(parser *parser);
+// The token k places after current, so peekToken(parser, 0) is current.
+// k must not exceed PARSER_LOOKAHEAD. With a streaming lexer only the lexeme
+// of the furthest token read is guaranteed to still be in the window.
+token peekToken(parser *parser, int k);
 astNode *parseExpression(parser *parser);
 astNode *parseStatement(parser *parser);
+// The body of a function node, parsed now if it was left lazy. The input
+// the function was parsed from must still be alive and unchanged. Nodes come
+// from the calling thread's arena if it has one, so use the arena the
+// function was parsed into. Returns NULL if the function has no body or the
+// body does not parse; errors in a lazy body only show up here.
+astNode *functionBody(astNode *function);
+
+// Gets each top-level statement in turn. The statement and everything under
+// it, names and string values included, are only valid during the call.
+// Returns false to stop parsing.
+typedef bool (*statementCallback)(astNode *statement, void *ctx);
+
+// Parses the rest of the input one statement at a time into an arena of its
+// own, which is reset after every callback. Unless keep_atoms is set, the
+// names and literals statements add to the atom tables are released too
+// (releaseAtoms in atom.h) once a few thousand have built up, so with a
+// stream lexer memory stays bounded by the largest statement rather than by
+// the input. While that is the case no other thread may use the atom tables.
+// Returns true if the input was parsed to the end, false if a statement
+// failed to parse or the callback stopped early.
+bool parseProgramStreaming(parser *parser, statementCallback callback, void *ctx);
+
+// The top-level statements of an input, in source order, as one body node.
+// complete is false if a statement failed to parse, where a parseStatement
+// loop would have stopped. Every node lives in one of arenas, so the tree
+// stays valid until freeParsedProgram.
+typedef struct {
+    astNode *body;
+    bool complete;
+    astArena *arenas;
+    int arena_count;
+} parsedProgram;
+
+// Parses the rest of lexer's input with the same result as a parseStatement
+// loop. Top-level declarations are split up by a brace-matching pre-scan and
+// parsed on up to threads workers, each into an arena of its own. Streams
+// are parsed serially. Returns false if memory ran out.
+bool parseProgramParallel(lexer *lexer, parsedProgram *program, int threads);
+void freeParsedProgram(parsedProgram *program);
 
 #endif
\ No newline at end of file